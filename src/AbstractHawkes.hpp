@@ -7,6 +7,8 @@
 #include <cmath>
 #include <complex>
 #include <future>
+#include <string>
+#include <vector>
 
 #ifdef USE_SIMD
 #include <emmintrin.h>
@@ -19,6 +21,7 @@
     #include "tbb/parallel_reduce.h"
     #include "tbb/blocked_range.h"
     #include "tbb/parallel_for.h"
+    #include "tbb/enumerable_thread_specific.h"
     #include "tbb/task_scheduler_init.h"
 #endif
 
@@ -29,6 +32,22 @@
 
 namespace hph {
 
+// Counters bumped whenever the corresponding engine input changes; cached results are tagged with
+// the version they were computed at, and {0, 0, 0} never matches
+struct StateVersion {
+    unsigned long parameters;
+    unsigned long times;
+    unsigned long locations;
+
+    bool operator==(const StateVersion& rhs) const {
+        return parameters == rhs.parameters && times == rhs.times && locations == rhs.locations;
+    }
+
+    bool operator!=(const StateVersion& rhs) const {
+        return !(*this == rhs);
+    }
+};
+
 class AbstractHawkes {
 public:
     AbstractHawkes(int embeddingDimension, int locationCount, long flags)
@@ -48,8 +67,67 @@ public:
     virtual void acceptState() = 0;
     virtual void setTimesData(double*, size_t)  = 0;
     virtual void setParameters(double*, size_t) = 0;
+
+    // Delivers all times and row-major locations from memory that owner keeps alive (e.g. a file mapping);
+    // double-precision CPU engines read them in place until an update copies them out, others copy them now
+    virtual void shareEvents(const double* times, const double* locations, std::shared_ptr<const void> owner) = 0;
+
+    // Log-likelihood, gradient (length 6) and self-excitation probabilities (length locationCount) from a
+    // single pass over the pairs; gradient and probsSelfExcite may be null
+    virtual void evaluateAll(double* logLikelihood, double* gradient, double* probsSelfExcite) = 0;
+
+    // Log-likelihoods (and, if gradients is not null, gradients) for count parameter vectors of length 6,
+    // without changing the engine's parameters
+    virtual void getSumOfLikContribsBatch(const double* parameters, int count,
+                                          double* logLikelihoods, double* gradients) = 0;
     virtual int getInternalDimension() = 0;
 
+    // Time-window truncation; a tolerance of 0 evaluates all pairs
+    virtual void setTruncation(double) = 0;
+    virtual double getTruncationErrorBound() = 0;
+
+    // Bytes held by the pairwise distance cache (0 when disabled)
+    virtual std::size_t getDistanceCacheFootprint() = 0;
+
+    // New engine with the same data, parameters and window that shares the read-only event store and the built
+    // pair structures (spatial index, neighbour list, distance cache); it sets no process-wide thread limit of its
+    // own, but runs under its caller's task_arena
+    virtual std::shared_ptr<AbstractHawkes> clone() = 0;
+
+    // Installs (true) or lifts (false) the process-wide limit of the engine's thread count that it sets on
+    // construction, e.g. while MultiChainDriver divides the threads between its chains instead
+    virtual void limitThreads(bool limit) = 0;
+
+    // Appends count events (times not before the last event, row-major locations) with amortised storage
+    // growth; cached per-event rates are updated in O(count * N) rather than recomputed. Discards stored state.
+    virtual void appendEvents(double* times, double* locations, size_t count) = 0;
+
+    // Keeps only events within length of the latest one, evicting older events now and on every append and
+    // compacting storage in place; 0 keeps all events
+    virtual void setWindow(double length) = 0;
+
+    // Conditional intensity lambda(x, t) of the stored events at count query points (row-major locations, any
+    // times); background and selfExcite, if not null, receive its two parts
+    virtual void evaluateIntensity(double* queryLocations, double* queryTimes, size_t count,
+                                   double* intensity, double* background, double* selfExcite) = 0;
+
+    // Expected event counts (the compensator) in count boxes: rectangles [lower, upper] (row-major, infinite
+    // bounds allowed) times windows [startTimes, endTimes]; background and selfExcite may be null
+    virtual void evaluateCompensator(double* lower, double* upper, double* startTimes, double* endTimes,
+                                     size_t count, double* expected, double* background, double* selfExcite) = 0;
+
+    // Binary snapshot of the events, parameters, stored state and cached sums, with an optional block of caller
+    // state (e.g. sampler adaptation) appended; loading resizes the engine to the snapshot's event count and
+    // resumes without recomputing anything that was known when it was saved
+    virtual void saveState(const std::string& path, const double* extra = nullptr, size_t extraLength = 0) = 0;
+    virtual void loadState(const std::string& path, std::vector<double>* extra = nullptr) = 0;
+
+    int getEmbeddingDimension() const { return embeddingDimension; }
+
+    int getLocationCount() const { return locationCount; }
+
+    long getFlags() const { return flags; }
+
 protected:
     int embeddingDimension;
     int locationCount;
@@ -57,6 +135,8 @@ protected:
     long flags;
 
     int updatedLocation = -1;
+
+    StateVersion version = {1, 1, 1};
 };
 
 typedef std::shared_ptr<hph::AbstractHawkes> SharedPtr;
@@ -3,12 +3,15 @@
 
 #include <cfloat>
 
+#include "isa.h"
+
 #ifdef USE_SIMD
 #include "xsimd/xsimd.hpp"
 #endif
 
 namespace hph {
 namespace math {
+HPH_ISA_NAMESPACE_BEGIN
 
 /*
  *  Mathlib : A C Library of Special Functions
@@ -614,6 +617,7 @@ double pdf(double value) { // standard normal density
 #endif
 		    return M_1_SQRT_2PI * exp(-0.5 * value * value);
 		}
+HPH_ISA_NAMESPACE_END
 } // namespace math
 } // namespace hph
 
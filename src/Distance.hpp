@@ -1,6 +1,7 @@
 #ifndef _DISTANCE_HPP
 #define _DISTANCE_HPP
 
+#include <iterator>
 #include <numeric>
 #include <vector>
 
@@ -11,8 +12,10 @@
 #endif
 
 #include "MemoryManagement.hpp"
+#include "isa.h"
 
 namespace hph {
+HPH_ISA_NAMESPACE_BEGIN
 
 struct Generic {};
 struct NonGeneric {};
@@ -22,6 +25,9 @@ struct NonGeneric {};
 #ifdef USE_AVX
     using D4 = xsimd::batch<double, 4>;
     using D4Bool = xsimd::batch_bool<double, 4>;
+
+    using S8 = xsimd::batch<float, 8>;
+    using S8Bool = xsimd::batch_bool<float, 8>;
 #endif
 
 #ifdef USE_SSE
@@ -40,6 +46,9 @@ using S4Bool = xsimd::batch_bool<float, 4>;
 #ifdef USE_AVX512
 using D8 = xsimd::batch<double, 8>;
 using D8Bool = xsimd::batch_bool<double, 8>;
+
+using S16 = xsimd::batch<float, 16>;
+using S16Bool = xsimd::batch_bool<float, 16>;
 #endif // USE_AVX512
 
 template <typename SimdType, typename RealType, typename Algorithm>
@@ -47,11 +56,17 @@ class DistanceDispatch {
 
 public:
 
-	using IteratorType = typename mm::MemoryManager<RealType>::iterator;
+	using IteratorType = const RealType*;
+
+	DistanceDispatch(const RealType* locations, const int i, const int embeddingDimension) :
+		i(i), embeddingDimension(embeddingDimension),
+		iterator(locations), start(locations + i * embeddingDimension) { }
 
-	DistanceDispatch(const mm::MemoryManager<RealType>& locations, const int i, const int embeddingDimension) :
-		locations(locations), i(i), embeddingDimension(embeddingDimension),
-		iterator(locations.begin()), start(iterator + i * embeddingDimension) { }
+	// Distances from row i of origins (e.g. query points) to the rows of locations
+	DistanceDispatch(const RealType* locations, const RealType* origins,
+	                 const int i, const int embeddingDimension) :
+		i(i), embeddingDimension(embeddingDimension),
+		iterator(locations), start(origins + i * embeddingDimension) { }
 
 
 	inline SimdType calculate(int j) const;
@@ -59,20 +74,19 @@ public:
 
 private:
 
-	const mm::MemoryManager<RealType>& locations;
 	const int i;
 	const int embeddingDimension;
 
-	const decltype(std::begin(locations)) iterator;
-	const decltype(std::begin(locations)) start;
+	const IteratorType iterator;
+	const IteratorType start;
  };
 
  namespace impl {
 
 	template <typename Iterator>
-	typename Iterator::value_type calculateDistanceGeneric2(Iterator iX, Iterator iY, int length) {
+	typename std::iterator_traits<Iterator>::value_type calculateDistanceGeneric2(Iterator iX, Iterator iY, int length) {
 
-		typename Iterator::value_type sum{0};
+		typename std::iterator_traits<Iterator>::value_type sum{0};
 
 		for (int i = 0; i < length; ++i, ++iX, ++iY) {
 			const auto diff = *iX - *iY;
@@ -123,9 +137,9 @@ private:
 #endif // USE_SIMD
 
     template <typename Iterator>
-    typename Iterator::value_type calculateDistanceScalar(Iterator x, Iterator y, int length) {
+    typename std::iterator_traits<Iterator>::value_type calculateDistanceScalar(Iterator x, Iterator y, int length) {
 
-        typename Iterator::value_type sum{0};
+        typename std::iterator_traits<Iterator>::value_type sum{0};
 
         for (int i = 0; i < 2; ++i, ++x, ++y) {
             const auto difference = *x - *y;
@@ -134,9 +148,21 @@ private:
         return std::sqrt(sum);
     }
 
+#ifdef USE_SIMD
+    // Fills a wide batch one distance per lane; spelling out 8 or 16 constructor arguments gains nothing
+    template <typename SimdType, typename Iterator, typename Calculate>
+    SimdType gatherDistances(Iterator start, Iterator iterator, int j, int embeddingDimension, Calculate calculate) {
+        alignas(64) typename SimdType::value_type lanes[SimdType::size];
+        for (std::size_t k = 0; k < SimdType::size; ++k) {
+            lanes[k] = calculate(start, iterator + (j + k) * embeddingDimension, embeddingDimension);
+        }
+        return SimdType(lanes, xsimd::aligned_mode());
+    }
+#endif // USE_SIMD
+
 	template <typename Iterator>
-	typename Iterator::value_type calculateDistanceGenericScalar(Iterator x, Iterator y, int length) {
-		typename Iterator::value_type sum{0};
+	typename std::iterator_traits<Iterator>::value_type calculateDistanceGenericScalar(Iterator x, Iterator y, int length) {
+		typename std::iterator_traits<Iterator>::value_type sum{0};
 
 		for (int i = 0; i < length; ++i, ++x, ++y) {
 			const auto difference = *x - *y;
@@ -432,6 +458,42 @@ inline double DistanceDispatch<double, double, NonGeneric>::calculate(int j) con
 	}
 
 #endif //USE_SSE
+
+#ifdef USE_AVX
+    template <>
+    inline S8 DistanceDispatch<S8, S8::value_type, Generic>::calculate(int j) const {
+        return impl::gatherDistances<S8>(start, iterator, j, embeddingDimension,
+                [](decltype(start) x, decltype(start) y, int length) {
+                    return impl::calculateDistanceGeneric2(x, y, length);
+                });
+    }
+
+    template <>
+    inline S8 DistanceDispatch<S8, S8::value_type, NonGeneric>::calculate(int j) const {
+        return impl::gatherDistances<S8>(start, iterator, j, embeddingDimension,
+                [](decltype(start) x, decltype(start) y, int length) {
+                    return impl::calculateDistance2(x, y, length, S8::value_type());
+                });
+    }
+#endif // USE_AVX
+
+#ifdef USE_AVX512
+    template <>
+    inline S16 DistanceDispatch<S16, S16::value_type, Generic>::calculate(int j) const {
+        return impl::gatherDistances<S16>(start, iterator, j, embeddingDimension,
+                [](decltype(start) x, decltype(start) y, int length) {
+                    return impl::calculateDistanceGeneric2(x, y, length);
+                });
+    }
+
+    template <>
+    inline S16 DistanceDispatch<S16, S16::value_type, NonGeneric>::calculate(int j) const {
+        return impl::gatherDistances<S16>(start, iterator, j, embeddingDimension,
+                [](decltype(start) x, decltype(start) y, int length) {
+                    return impl::calculateDistance2(x, y, length, S16::value_type());
+                });
+    }
+#endif // USE_AVX512
 #endif //USE_SIMD
 
 	template <>
@@ -498,6 +560,16 @@ public:
     inline void SimdHelper<D4, D4::value_type>::put(D4 x, double* iterator) {
         x.store_unaligned(iterator);
     }
+
+    template <>
+    inline S8 SimdHelper<S8, S8::value_type>::get(const float* iterator) {
+        return S8(iterator, xsimd::unaligned_mode());
+    }
+
+    template <>
+    inline void SimdHelper<S8, S8::value_type>::put(S8 x, float* iterator) {
+        x.store_unaligned(iterator);
+    }
 #endif
 #ifdef USE_SSE
     template <>
@@ -534,6 +606,16 @@ public:
     inline void SimdHelper<D8, D8::value_type>::put(D8 x, double* iterator) {
         x.store_unaligned(iterator);
     }
+
+    template <>
+    inline S16 SimdHelper<S16, S16::value_type>::get(const float* iterator) {
+        return S16(iterator, xsimd::unaligned_mode());
+    }
+
+    template <>
+    inline void SimdHelper<S16, S16::value_type>::put(S16 x, float* iterator) {
+        x.store_unaligned(iterator);
+    }
 #endif // USE_AVX512
 
     template <>
@@ -555,6 +637,24 @@ public:
     inline void SimdHelper<float, float>::put(float x, float* iterator) {
         *iterator = x;
     }
+
+    // Reads pre-computed (e.g. gathered) distances with the same interface as DistanceDispatch
+    template <typename SimdType, typename RealType>
+    class StreamDispatch {
+
+    public:
+
+        StreamDispatch(const RealType* distances) : distances(distances) { }
+
+        inline SimdType calculate(int j) const {
+            return SimdHelper<SimdType, RealType>::get(distances + j);
+        }
+
+    private:
+
+        const RealType* distances;
+    };
+HPH_ISA_NAMESPACE_END
 } // namespace hph
 
 #endif // _DISTANCE_HPP
@@ -0,0 +1,209 @@
+#ifndef _DISTANCE_CACHE_HPP
+#define _DISTANCE_CACHE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "MemoryManagement.hpp"
+#include "isa.h"
+
+namespace hph {
+HPH_ISA_NAMESPACE_BEGIN
+
+    namespace half {
+
+        // IEEE 754 binary16 conversions, round-to-nearest-even
+        inline std::uint16_t fromFloat(const float value) {
+
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            const std::uint16_t sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+            bits &= 0x7fffffffu;
+
+            if (bits >= 0x7f800000u) { // Inf or NaN
+                return sign | 0x7c00u | (bits > 0x7f800000u ? 0x0200u : 0u);
+            }
+
+            if (bits >= 0x477ff000u) { // Rounds above 65504
+                return sign | 0x7c00u;
+            }
+
+            if (bits < 0x38800000u) { // Subnormal or zero
+                if (bits < 0x33000000u) {
+                    return sign;
+                }
+                const std::uint32_t exponent = bits >> 23;
+                const std::uint32_t mantissa = (bits & 0x7fffffu) | 0x800000u;
+                const std::uint32_t shift = 126u - exponent;
+
+                std::uint32_t result = mantissa >> shift;
+                const std::uint32_t remainder = mantissa & ((1u << shift) - 1u);
+                const std::uint32_t halfway = 1u << (shift - 1u);
+                if (remainder > halfway || (remainder == halfway && (result & 1u))) {
+                    ++result;
+                }
+                return sign | static_cast<std::uint16_t>(result);
+            }
+
+            std::uint32_t result = (bits - 0x38000000u) >> 13; // Re-bias exponent
+            const std::uint32_t remainder = bits & 0x1fffu;
+            if (remainder > 0x1000u || (remainder == 0x1000u && (result & 1u))) {
+                ++result;
+            }
+            return sign | static_cast<std::uint16_t>(result);
+        }
+
+        inline float toFloat(const std::uint16_t value) {
+
+            const std::uint32_t sign = static_cast<std::uint32_t>(value & 0x8000u) << 16;
+            std::uint32_t exponent = (value >> 10) & 0x1fu;
+            std::uint32_t mantissa = value & 0x3ffu;
+
+            std::uint32_t bits;
+            if (exponent == 0x1fu) {
+                bits = sign | 0x7f800000u | (mantissa << 13);
+            } else if (exponent != 0) {
+                bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+            } else if (mantissa == 0) {
+                bits = sign;
+            } else { // Subnormal
+                exponent = 113u;
+                while (!(mantissa & 0x400u)) {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+            }
+
+            float result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+
+    } // namespace half
+
+    enum class CacheStorage {
+        Half,
+        Float,
+        Double
+    };
+
+    // Strict upper triangle of the pairwise distance matrix, stored row-major
+    template <typename RealType>
+    class DistanceCache {
+    public:
+
+        DistanceCache() : count(0), storage(CacheStorage::Float) { }
+
+        static std::size_t footprint(const std::size_t count, const CacheStorage storage) {
+            const std::size_t pairs = count < 2 ? 0 : count * (count - 1) / 2;
+            switch (storage) {
+                case CacheStorage::Half:
+                    return pairs * sizeof(std::uint16_t);
+                case CacheStorage::Float:
+                    return pairs * sizeof(float);
+                default:
+                    return pairs * sizeof(double);
+            }
+        }
+
+        void resize(const int locationCount, const CacheStorage cacheStorage) {
+            count = locationCount;
+            storage = cacheStorage;
+            const std::size_t pairs = static_cast<std::size_t>(count) * (count - 1) / 2;
+
+            halfDistances.clear();
+            floatDistances.clear();
+            doubleDistances.clear();
+
+            switch (storage) {
+                case CacheStorage::Half:
+                    halfDistances.resize(pairs);
+                    break;
+                case CacheStorage::Float:
+                    floatDistances.resize(pairs);
+                    break;
+                default:
+                    doubleDistances.resize(pairs);
+            }
+        }
+
+        // Requires i < j
+        void set(const int i, const int j, const RealType distance) {
+            const auto k = index(i, j);
+            switch (storage) {
+                case CacheStorage::Half:
+                    halfDistances[k] = half::fromFloat(static_cast<float>(distance));
+                    break;
+                case CacheStorage::Float:
+                    floatDistances[k] = static_cast<float>(distance);
+                    break;
+                default:
+                    doubleDistances[k] = static_cast<double>(distance);
+            }
+        }
+
+        // Writes distances from location i to locations [begin, end) into out
+        void decodeRow(const int i, const int begin, const int end, RealType* out) const {
+            switch (storage) {
+                case CacheStorage::Half:
+                    decodeRow(i, begin, end, out, halfDistances, [](const std::uint16_t x) {
+                        return static_cast<RealType>(half::toFloat(x));
+                    });
+                    break;
+                case CacheStorage::Float:
+                    decodeRow(i, begin, end, out, floatDistances, [](const float x) {
+                        return static_cast<RealType>(x);
+                    });
+                    break;
+                default:
+                    decodeRow(i, begin, end, out, doubleDistances, [](const double x) {
+                        return static_cast<RealType>(x);
+                    });
+            }
+        }
+
+    private:
+
+        std::size_t index(const std::size_t i, const std::size_t j) const {
+            return i * (2 * count - i - 1) / 2 + (j - i - 1);
+        }
+
+        template <typename StorageType, typename Convert>
+        void decodeRow(const int i, const int begin, const int end, RealType* out,
+                       const mm::MemoryManager<StorageType>& distances,
+                       Convert convert) const {
+
+            const int lowerEnd = std::min(i, end);
+            for (int j = begin; j < lowerEnd; ++j) { // Column i of earlier rows
+                *out++ = convert(distances[index(j, i)]);
+            }
+
+            if (begin <= i && i < end) {
+                *out++ = RealType(0);
+            }
+
+            const int upperBegin = std::max(i + 1, begin);
+            if (upperBegin < end) { // Contiguous part of row i
+                const auto* row = &distances[index(i, upperBegin)];
+                for (int j = upperBegin; j < end; ++j) {
+                    *out++ = convert(*row++);
+                }
+            }
+        }
+
+        std::size_t count;
+        CacheStorage storage;
+
+        mm::MemoryManager<std::uint16_t> halfDistances;
+        mm::MemoryManager<float> floatDistances;
+        mm::MemoryManager<double> doubleDistances;
+    };
+
+HPH_ISA_NAMESPACE_END
+} // namespace hph
+
+#endif // _DISTANCE_CACHE_HPP
@@ -0,0 +1,226 @@
+#ifndef _EVENT_FILE_HPP
+#define _EVENT_FILE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef RBUILD
+#include <Rcpp.h>
+#endif
+
+#include "AbstractHawkes.hpp"
+#include "isa.h"
+
+namespace hph {
+HPH_ISA_NAMESPACE_BEGIN
+
+    // Binary event file, in native byte order: a 64-byte header, then eventCount times and eventCount *
+    // embeddingDimension row-major locations, each starting at a 64-byte aligned offset. Locations are stored
+    // in the engine's own layout, so double-precision engines read them straight out of the mapping.
+    struct EventFileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t embeddingDimension;
+        std::uint64_t eventCount;
+        std::uint64_t timesOffset;
+        std::uint64_t locationsOffset;
+        char padding[24];
+    };
+
+    static_assert(sizeof(EventFileHeader) == 64, "Event file header must be 64 bytes");
+
+    namespace eventfile {
+
+        static const char magic[8] = {'H', 'P', 'H', 'E', 'V', 'T', 'S', '\0'};
+        static const std::uint32_t version = 1;
+        static const std::uint64_t alignment = 64;
+
+        inline std::uint64_t align(const std::uint64_t offset) {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        inline void fail(const std::string& message) {
+#ifdef RBUILD
+            Rcpp::stop(message);
+#else
+            std::cerr << message << std::endl;
+            exit(-1);
+#endif
+        }
+
+    } // namespace eventfile
+
+    inline void writeEventFile(const std::string& path, const double* times, const double* locations,
+                               const std::size_t eventCount, const int embeddingDimension) {
+
+        if (!std::is_sorted(times, times + eventCount)) {
+            eventfile::fail("Event times must be sorted");
+        }
+
+        EventFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, eventfile::magic, sizeof(header.magic));
+        header.version = eventfile::version;
+        header.embeddingDimension = static_cast<std::uint32_t>(embeddingDimension);
+        header.eventCount = eventCount;
+        header.timesOffset = eventfile::align(sizeof(header));
+        header.locationsOffset = eventfile::align(header.timesOffset + eventCount * sizeof(double));
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            eventfile::fail("Unable to open event file " + path + " for writing");
+        }
+
+        const mm::MemoryManager<char> zeros(eventfile::alignment, 0);
+        auto pad = [&file, &zeros](const std::uint64_t offset) {
+            file.write(zeros.data(), offset - static_cast<std::uint64_t>(file.tellp()));
+        };
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pad(header.timesOffset);
+        file.write(reinterpret_cast<const char*>(times), eventCount * sizeof(double));
+        pad(header.locationsOffset);
+        file.write(reinterpret_cast<const char*>(locations), eventCount * embeddingDimension * sizeof(double));
+
+        if (!file) {
+            eventfile::fail("Unable to write event file " + path);
+        }
+    }
+
+    // Whole-file read-only view. On POSIX systems the file is mapped, so pages are faulted in on first use and
+    // shared with the page cache; elsewhere it is read into memory.
+    class MappedFile {
+    public:
+
+        explicit MappedFile(const std::string& path) : base(nullptr), length(0) {
+#ifdef _WIN32
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) {
+                eventfile::fail("Unable to open " + path);
+            }
+            length = static_cast<std::size_t>(file.tellg());
+            contents.resize(length / sizeof(double) + 1);
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(contents.data()), length);
+            base = reinterpret_cast<char*>(contents.data());
+#else
+            const int descriptor = open(path.c_str(), O_RDONLY);
+            if (descriptor < 0) {
+                eventfile::fail("Unable to open " + path);
+            }
+
+            struct stat status;
+            fstat(descriptor, &status);
+            length = static_cast<std::size_t>(status.st_size);
+
+            if (length > 0) {
+                void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                base = address == MAP_FAILED ? nullptr : static_cast<char*>(address);
+            }
+            close(descriptor);
+
+            if (base != nullptr) {
+                madvise(base, length, MADV_SEQUENTIAL);
+            }
+#endif
+            if (base == nullptr) {
+                eventfile::fail("Unable to map " + path);
+            }
+        }
+
+        ~MappedFile() {
+#ifndef _WIN32
+            if (base != nullptr) {
+                munmap(base, length);
+            }
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const {
+            return base;
+        }
+
+        std::size_t size() const {
+            return length;
+        }
+
+    private:
+        char* base;
+        std::size_t length;
+#ifdef _WIN32
+        mm::MemoryManager<double> contents;
+#endif
+    };
+
+    class MappedEventFile {
+    public:
+
+        explicit MappedEventFile(const std::string& path) : file(std::make_shared<MappedFile>(path)) {
+            if (file->size() < sizeof(EventFileHeader)) {
+                eventfile::fail("Invalid event file " + path);
+            }
+
+            std::memcpy(&header, file->data(), sizeof(header));
+            if (std::memcmp(header.magic, eventfile::magic, sizeof(header.magic)) != 0 ||
+                header.version != eventfile::version ||
+                header.timesOffset % eventfile::alignment != 0 ||
+                header.locationsOffset % eventfile::alignment != 0 ||
+                header.timesOffset + header.eventCount * sizeof(double) > header.locationsOffset ||
+                header.locationsOffset + header.eventCount * header.embeddingDimension * sizeof(double) > file->size()) {
+                eventfile::fail("Invalid event file " + path);
+            }
+        }
+
+        int getEmbeddingDimension() const {
+            return static_cast<int>(header.embeddingDimension);
+        }
+
+        int getEventCount() const {
+            return static_cast<int>(header.eventCount);
+        }
+
+        const double* getTimes() const {
+            return reinterpret_cast<const double*>(file->data() + header.timesOffset);
+        }
+
+        const double* getLocations() const {
+            return reinterpret_cast<const double*>(file->data() + header.locationsOffset);
+        }
+
+        // Delivers all events to an engine created with the file's dimension and event count; the engine keeps
+        // the mapping alive for as long as it reads from it
+        void load(AbstractHawkes& engine) const {
+            if (engine.getEmbeddingDimension() != getEmbeddingDimension()) {
+                eventfile::fail("Event file does not match the engine's embedding dimension");
+            }
+            if (engine.getLocationCount() != getEventCount()) {
+                eventfile::fail("Event file does not match the engine's event count");
+            }
+            engine.shareEvents(getTimes(), getLocations(), file);
+        }
+
+    private:
+        std::shared_ptr<MappedFile> file;
+        EventFileHeader header;
+    };
+
+HPH_ISA_NAMESPACE_END
+} // namespace hph
+
+#endif // _EVENT_FILE_HPP
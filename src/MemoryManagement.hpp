@@ -3,11 +3,14 @@
 
 #include <vector>
 #include <algorithm>
+#include <memory>
 
 #include "aligned_allocator.hpp"
+#include "isa.h"
 
 namespace hph {
 namespace mm {
+HPH_ISA_NAMESPACE_BEGIN
 
 // enum class Alignment : size_t
 // {
@@ -30,6 +33,53 @@ namespace mm {
 template <typename T>
 using MemoryManager = std::vector<T, util::aligned_allocator<T, 16> >;
 
+// Read-only view of a reference-counted buffer; copies share storage and modify() detaches first. The buffer
+// may also be borrowed from memory that a keeper owns (e.g. a file mapping), in which case modify() copies it out.
+template <typename T>
+class SharedMemoryManager {
+public:
+    using const_iterator = const T*;
+
+    explicit SharedMemoryManager(std::size_t size = 0) : store(std::make_shared<MemoryManager<T>>(size)),
+            borrowed(nullptr), length(0) { }
+
+    SharedMemoryManager(std::shared_ptr<const void> keeper, const T* borrowed, std::size_t length) :
+            keeper(std::move(keeper)), borrowed(borrowed), length(length) { }
+
+    const T& operator[](std::size_t i) const { return data()[i]; }
+    const T* data() const { return store ? store->data() : borrowed; }
+    std::size_t size() const { return store ? store->size() : length; }
+
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + size(); }
+
+    MemoryManager<T>& modify() {
+        if (!store) {
+            store = std::make_shared<MemoryManager<T>>(borrowed, borrowed + length);
+            keeper.reset();
+        } else if (store.use_count() > 1) {
+            store = std::make_shared<MemoryManager<T>>(*store);
+        }
+        return *store;
+    }
+
+private:
+    std::shared_ptr<MemoryManager<T>> store;
+    std::shared_ptr<const void> keeper;
+    const T* borrowed;
+    std::size_t length;
+};
+
+
+// Resizes with geometric capacity growth, so that repeated appends are amortised O(1) per element
+template <typename Vector>
+void grow(Vector& vector, std::size_t size) {
+    if (size > vector.capacity()) {
+        vector.reserve(std::max(size, 2 * vector.capacity()));
+    }
+    vector.resize(size);
+}
+
 
 // Copy functionality
 
@@ -86,6 +136,7 @@ void bufferedCopy(mm::MemoryManager<float>::iterator begin,
             }
         }
 
+HPH_ISA_NAMESPACE_END
     } // namespace mm
 } // namespace hph
 
@@ -0,0 +1,83 @@
+#ifndef _MULTI_CHAIN_HPP
+#define _MULTI_CHAIN_HPP
+
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define TBB_PREVIEW_GLOBAL_CONTROL 1
+#include "tbb/global_control.h"
+#include "tbb/task_arena.h"
+
+#ifdef RBUILD
+#include <Rcpp.h>
+#endif
+
+#include "AbstractHawkes.hpp"
+#include "flags.h"
+
+namespace hph {
+
+    // Runs one task per chain, each on its own clone of a single engine (sharing its event store and pair
+    // structures) and inside its own task_arena, so chains do not compete for the same TBB workers. The driver
+    // owns the thread budget, chainCount * threadsPerChain, in place of the engine's own limit while it exists.
+    class MultiChainDriver {
+    public:
+
+        MultiChainDriver(AbstractHawkes& engine, const int chainCount, const int threadsPerChain)
+            : source(engine),
+              control(tbb::global_control::max_allowed_parallelism, chainCount * threadsPerChain) {
+
+            if (threadsPerChain > 1 && !(engine.getFlags() & hph::Flags::TBB)) {
+#ifdef RBUILD
+                Rcpp::stop("More than one thread per chain needs an engine created with TBB");
+#else
+                std::cerr << "More than one thread per chain needs an engine created with TBB" << std::endl;
+                exit(-1);
+#endif
+            }
+
+            source.limitThreads(false); // TBB applies the smallest of all active limits
+            for (int chain = 0; chain < chainCount; ++chain) {
+                engines.push_back(engine.clone());
+                arenas.emplace_back(new tbb::task_arena(threadsPerChain));
+            }
+        }
+
+        ~MultiChainDriver() {
+            source.limitThreads(true);
+        }
+
+        // Calls function(chain, engine) for every chain concurrently and waits for all to finish
+        template <typename Function>
+        void run(Function function) {
+
+            std::vector<std::thread> threads;
+            for (int chain = 0; chain < static_cast<int>(engines.size()); ++chain) {
+                threads.emplace_back([this, chain, &function]() {
+                    arenas[chain]->execute([this, chain, &function]() {
+                        function(chain, *engines[chain]);
+                    });
+                });
+            }
+
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        }
+
+        AbstractHawkes& getEngine(const int chain) {
+            return *engines[chain];
+        }
+
+    private:
+        AbstractHawkes& source;
+        tbb::global_control control;
+        std::vector<std::shared_ptr<AbstractHawkes>> engines;
+        std::vector<std::unique_ptr<tbb::task_arena>> arenas;
+    };
+
+} // namespace hph
+
+#endif // _MULTI_CHAIN_HPP
@@ -1,27 +1,74 @@
 #ifndef _NEWHAWKES_HPP
 #define _NEWHAWKES_HPP
 
+#include "isa.h"
+
+// Every library header the engine pulls in, ahead of the first SIMD code; see isa.h
+HPH_LIBRARY_CODE_BEGIN
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #define TBB_PREVIEW_GLOBAL_CONTROL 1
 #include "tbb/global_control.h"
+#include "tbb/parallel_reduce.h"
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/enumerable_thread_specific.h"
+#include "tbb/task_scheduler_init.h"
 
 #ifdef RBUILD
 #include <Rcpp.h>
-#else
-#include <iostream>
 #endif
 
+#include "ThreadPool.h"
+HPH_LIBRARY_CODE_END
+
 
 //#define XSIMD_ENABLE_FALLBACK
 
 #include "xsimd/xsimd.hpp"
 #include "AbstractHawkes.hpp"
 #include "Distance.hpp"
+#include "SpatialIndex.hpp"
+#include "DistanceCache.hpp"
+#include "StateFile.hpp"
 
 namespace adhoc {
 
+#ifndef APPLE_COMP
+    // The libm headers declare exp() with C linkage; kept apart, the exp() below is an ordinary per-ISA function
+    namespace fdlibm {
+#include "libm/math.h"
+#include "libm/math_private.h"
+    }
+    using namespace fdlibm;
+#endif
+
+HPH_ISA_NAMESPACE_BEGIN
+
     template <typename T>
     T exp(T x) {
         return	xsimd::exp(x);
@@ -29,9 +76,6 @@ namespace adhoc {
 
 #ifndef APPLE_COMP
 
-#include "libm/math.h"
-#include "libm/math_private.h"
-
     static const double
             one	= 1.0,
             halF[2]	= {0.5,-0.5,},
@@ -50,7 +94,7 @@ namespace adhoc {
             P4   = -1.65339022054652515390e-06, /* 0xBEBBBD41, 0xC5D26BF1 */
             P5   =  4.13813679705723846039e-08; /* 0x3E663769, 0x72BEA4D0 */
 
-    double exp(double x) {
+    inline double exp(double x) {
         double y,hi=0.0,lo=0.0,c,t;
         int32_t k=0,xsb;
         u_int32_t hx;
@@ -109,9 +153,12 @@ namespace adhoc {
     T pdf_new(T value) {
         return M_1_SQRT_2PI * adhoc::exp(-0.5 * value * value);
     }
-}
+
+HPH_ISA_NAMESPACE_END
+} // namespace adhoc
 
 namespace hph {
+HPH_ISA_NAMESPACE_BEGIN
 
     struct DefaultOut {
 
@@ -140,12 +187,22 @@ namespace hph {
 	struct DoubleNoSimdTypeInfo {
 		using BaseType = double;
 		using SimdType = double;
+		using SumType = double;
 		static const int SimdSize = 1;
 	};
 
     struct FloatNoSimdTypeInfo {
         using BaseType = float;
         using SimdType = float;
+        using SumType = float;
+        static const int SimdSize = 1;
+    };
+
+    // Single-precision storage and pair kernels with compensated per-row sums and double reductions
+    struct FloatMixedNoSimdTypeInfo {
+        using BaseType = float;
+        using SimdType = float;
+        using SumType = double;
         static const int SimdSize = 1;
     };
 
@@ -155,12 +212,21 @@ namespace hph {
     struct DoubleSseTypeInfo {
         using BaseType = double;
         using SimdType = xsimd::batch<double, 2>;
+        using SumType = double;
         static const int SimdSize = 2;
     };
 
     struct FloatSseTypeInfo {
         using BaseType = float;
         using SimdType = xsimd::batch<float, 4>;
+        using SumType = float;
+        static const int SimdSize = 4;
+    };
+
+    struct FloatMixedSseTypeInfo {
+        using BaseType = float;
+        using SimdType = xsimd::batch<float, 4>;
+        using SumType = double;
         static const int SimdSize = 4;
     };
 #endif
@@ -169,25 +235,93 @@ namespace hph {
     struct DoubleAvxTypeInfo {
         using BaseType = double;
         using SimdType = xsimd::batch<double, 4>;
+        using SumType = double;
         static const int SimdSize = 4;
     };
+
+    struct FloatAvxTypeInfo {
+        using BaseType = float;
+        using SimdType = xsimd::batch<float, 8>;
+        using SumType = float;
+        static const int SimdSize = 8;
+    };
+
+    struct FloatMixedAvxTypeInfo {
+        using BaseType = float;
+        using SimdType = xsimd::batch<float, 8>;
+        using SumType = double;
+        static const int SimdSize = 8;
+    };
 #endif
 
 #ifdef USE_AVX512
     struct DoubleAvx512TypeInfo {
         using BaseType = double;
         using SimdType = xsimd::batch<double, 8>;
+        using SumType = double;
         static const int SimdSize = 8;
     };
+
+    struct FloatAvx512TypeInfo {
+        using BaseType = float;
+        using SimdType = xsimd::batch<float, 16>;
+        using SumType = float;
+        static const int SimdSize = 16;
+    };
+
+    struct FloatMixedAvx512TypeInfo {
+        using BaseType = float;
+        using SimdType = xsimd::batch<float, 16>;
+        using SumType = double;
+        static const int SimdSize = 16;
+    };
 #endif
 
 #endif
 
+    template <typename T, int N>
+    struct LoopTypeInfo {
+        using SimdType = T;
+        static const int SimdSize = N;
+    };
+
+    // Kahan-compensated running sum per lane; the represented value is sum - compensation
+    template <typename T>
+    struct CompensatedSum {
+        T sum;
+        T compensation;
+
+        explicit CompensatedSum(const T zero) : sum(zero), compensation(zero) { }
+
+        CompensatedSum& operator+=(const T x) {
+            const T y = x - compensation;
+            const T t = sum + y;
+            compensation = (t - sum) - y;
+            sum = t;
+            return *this;
+        }
+    };
+
 template <typename TypeInfo, typename ParallelType>
 class NewHawkes : public AbstractHawkes {
 public:
 
 	using RealType = typename TypeInfo::BaseType;
+	using SumType = typename TypeInfo::SumType; // Row sums, the rates built from them and reductions
+
+	// Lanes of a row sum: compensated when reduced into a wider SumType
+	template <typename SimdType>
+	using LaneSum = typename std::conditional<std::is_same<SumType, RealType>::value,
+	                                          SimdType, CompensatedSum<SimdType>>::type;
+
+    struct KernelParameters {
+        double sigmaXprec;
+        double tauXprec;
+        double tauTprec;
+        double omega;
+        double theta;
+        double mu0;
+    };
 
     NewHawkes(int embeddingDimension, int locationCount, long flags, int threads)
         : AbstractHawkes(embeddingDimension, locationCount, flags),
@@ -217,7 +351,31 @@ public:
           ratesVectorPtr(&ratesVector),
           gradientPtr(&gradient),
 
+          backgroundRates(locationCount),
+          selfExciteRates(locationCount),
+          backgroundIntegral(0.0), selfExciteDecay(0.0),
+          storedBackgroundIntegral(0.0), storedSelfExciteDecay(0.0),
+
+          skippedCounts(locationCount),
+          truncationTolerance(0.0),
+          truncationErrorBound(0.0),
+          windowLength(0.0),
+
+          spatialIndex(std::make_shared<SpatialIndex<RealType>>(embeddingDimension)),
+          neighbourList(std::make_shared<NeighbourList>()),
+          builtSpatialCutoff(0.0), builtBackgroundLag(0.0), builtSelfExciteLag(0.0),
+          neighbourListKnown(false),
+          distanceCache(std::make_shared<DistanceCache<RealType>>()),
+          distanceCacheKnown(false),
+
           isStoredLikContribsEmpty(false),
+          ratesKnown(false),
+          storedRatesKnown(false),
+
+          likelihoodVersion{0, 0, 0},
+          gradientVersion{0, 0, 0},
+          probsVersion{0, 0, 0},
+          storedLikelihoodKnown(false),
 
           nThreads(threads)
     {
@@ -237,6 +395,66 @@ public:
 
 
 
+    // Clone: shares the event store and the built pair structures, and sizes only the per-engine caches
+    NewHawkes(const NewHawkes& source)
+        : AbstractHawkes(source),
+          sigmaXprec(source.sigmaXprec), storedSigmaXprec(source.sigmaXprec),
+          tauXprec(source.tauXprec), storedTauXprec(source.tauXprec),
+          tauTprec(source.tauTprec), storedTauTprec(source.tauTprec),
+          omega(source.omega), storedOmega(source.omega),
+          theta(source.theta), storedTheta(source.theta),
+          mu0(source.mu0), storedMu0(source.mu0),
+
+          sumOfLikContribs(0.0), storedSumOfLikContribs(0.0),
+
+          times(source.times),
+
+          locations0(*source.locationsPtr),
+          locations1(*source.locationsPtr),
+
+          locationsPtr(&locations0),
+          storedLocationsPtr(&locations1),
+
+          probsSelfExcite(locationCount),
+          probsSelfExcitePtr(&probsSelfExcite),
+
+          likContribs(locationCount),
+          storedLikContribs(locationCount),
+
+          ratesVectorPtr(&ratesVector),
+          gradientPtr(&gradient),
+
+          backgroundRates(locationCount),
+          selfExciteRates(locationCount),
+          backgroundIntegral(0.0), selfExciteDecay(0.0),
+          storedBackgroundIntegral(0.0), storedSelfExciteDecay(0.0),
+
+          skippedCounts(locationCount),
+          truncationTolerance(source.truncationTolerance),
+          truncationErrorBound(0.0),
+          windowLength(source.windowLength),
+
+          spatialIndex(source.spatialIndex),
+          neighbourList(source.neighbourList),
+          builtSpatialCutoff(source.builtSpatialCutoff),
+          builtBackgroundLag(source.builtBackgroundLag),
+          builtSelfExciteLag(source.builtSelfExciteLag),
+          neighbourListKnown(source.neighbourListKnown),
+          distanceCache(source.distanceCache),
+          distanceCacheKnown(source.distanceCacheKnown),
+
+          isStoredLikContribsEmpty(false),
+          ratesKnown(false),
+          storedRatesKnown(false),
+
+          likelihoodVersion{0, 0, 0},
+          gradientVersion{0, 0, 0},
+          probsVersion{0, 0, 0},
+          storedLikelihoodKnown(false),
+
+          nThreads(source.nThreads)
+    { }
+
     virtual ~NewHawkes() { }
 
 	int getInternalDimension() { return embeddingDimension; }
@@ -268,30 +486,50 @@ public:
         }
 
         mm::bufferedCopy(location, location + length,
-                         begin(*locationsPtr) + offset,
+                         begin(locationsPtr->modify()) + offset,
                          buffer
         );
 
+        invalidateSpatialIndex();
+        neighbourListKnown = false;
+        distanceCacheKnown = false;
+        ratesKnown = false;
+        ++version.locations;
 //        sumOfIncrementsKnown = false;
     }
 
     double getSumOfLikContribs() {
-        // TODO do lazy computation (i.e., check if changed)
-        sumOfLikContribs = computeSumOfLikContribsGeneric<typename TypeInfo::SimdType, TypeInfo::SimdSize, Generic>();
+        if (likelihoodVersion != version) {
+            if (!ratesKnown) {
+                computeRatesGeneric<typename TypeInfo::SimdType, TypeInfo::SimdSize, Generic>();
+            }
+            sumOfLikContribs = computeSumOfLikContribsGeneric();
+            likelihoodVersion = version;
+        }
     	return sumOfLikContribs;
  	}
 
     void storeState() {
     	storedSumOfLikContribs = sumOfLikContribs;
-        sigmaXprec = storedSigmaXprec;
-        tauXprec = storedTauXprec;
-        tauTprec = storedTauTprec;
-        omega = storedOmega;
-        theta = storedTheta;
-        mu0 = storedMu0;
-
-        std::copy(begin(*locationsPtr), end(*locationsPtr),
-                  begin(*storedLocationsPtr));
+    	storedLikelihoodKnown = likelihoodVersion == version;
+        storedSigmaXprec = sigmaXprec;
+        storedTauXprec = tauXprec;
+        storedTauTprec = tauTprec;
+        storedOmega = omega;
+        storedTheta = theta;
+        storedMu0 = mu0;
+
+        *storedLocationsPtr = *locationsPtr; // Shares storage until the next update
+
+        // O(N) copy, so that restoring after a rejected kernel or location move skips the O(N^2) rates pass
+        storedRatesKnown = ratesKnown;
+        if (ratesKnown) {
+            storedBackgroundRates = backgroundRates;
+            storedSelfExciteRates = selfExciteRates;
+            storedSkippedCounts = skippedCounts;
+            storedBackgroundIntegral = backgroundIntegral;
+            storedSelfExciteDecay = selfExciteDecay;
+        }
     }
 
     void acceptState() {
@@ -303,7 +541,12 @@ public:
     }
 
     void restoreState() {
-    	sumOfLikContribs = storedSumOfLikContribs;
+
+        const bool kernelChanged = sigmaXprec != storedSigmaXprec || tauXprec != storedTauXprec ||
+                tauTprec != storedTauTprec || omega != storedOmega;
+        const bool parametersChanged = kernelChanged || theta != storedTheta || mu0 != storedMu0;
+        // Stored locations share the current buffer until an update copies it
+        const bool locationsChanged = storedLocationsPtr->data() != locationsPtr->data();
 
         sigmaXprec = storedSigmaXprec;
         tauXprec = storedTauXprec;
@@ -315,21 +558,85 @@ public:
         auto tmp1 = storedLocationsPtr;
         storedLocationsPtr = locationsPtr;
         locationsPtr = tmp1;
+
+        if (locationsChanged) { // Index and list are still rebuilt if the restored cut-offs exceed the built ones
+            invalidateSpatialIndex();
+            neighbourListKnown = false;
+            distanceCacheKnown = false;
+        }
+
+        // Rates depend only on the kernel parameters and the locations; otherwise the snapshot is put back
+        if (kernelChanged || locationsChanged) {
+            if (storedRatesKnown) {
+                std::swap(backgroundRates, storedBackgroundRates);
+                std::swap(selfExciteRates, storedSelfExciteRates);
+                std::swap(skippedCounts, storedSkippedCounts);
+                backgroundIntegral = storedBackgroundIntegral;
+                selfExciteDecay = storedSelfExciteDecay;
+            }
+            ratesKnown = storedRatesKnown;
+            storedRatesKnown = false;
+        }
+
+        if (parametersChanged) {
+            ++version.parameters;
+        }
+        if (locationsChanged) {
+            ++version.locations;
+        }
+        if (parametersChanged || locationsChanged) {
+            sumOfLikContribs = storedSumOfLikContribs;
+            likelihoodVersion = storedLikelihoodKnown ? version : StateVersion{0, 0, 0};
+        }
     }
 
     void setTimesData(double* data, size_t length) {
         assert(length == times.size());
-        mm::bufferedCopy(data, data + length, begin(times), buffer);
+        mm::bufferedCopy(data, data + length, begin(times.modify()), buffer);
+        neighbourListKnown = false;
+        ratesKnown = false;
+        storedRatesKnown = false;
+        storedLikelihoodKnown = false;
+        ++version.times;
+    }
+
+    void shareEvents(const double* timesData, const double* locationsData, std::shared_ptr<const void> owner) {
+        share(times, timesData, locationCount, owner);
+        share(*locationsPtr, locationsData, locationCount * embeddingDimension, owner);
+
+        // As setTimesData() and updateLocations(-1)
+        invalidateSpatialIndex();
+        neighbourListKnown = false;
+        distanceCacheKnown = false;
+        ratesKnown = false;
+        storedRatesKnown = false;
+        storedLikelihoodKnown = false;
+        ++version.times;
+        ++version.locations;
     }
 
     void getProbsSelfExcite(double* result, size_t length) {
         assert (length == locationCount);
-        computeProbsSelfExcite<typename TypeInfo::SimdType, TypeInfo::SimdSize, Generic>();
+        if (probsVersion != version) {
+            if (!ratesKnown) {
+                computeRatesGeneric<typename TypeInfo::SimdType, TypeInfo::SimdSize, Generic>();
+            }
+            computeProbsSelfExcite();
+            probsVersion = version;
+        }
         mm::bufferedCopy(std::begin(*probsSelfExcitePtr), std::end(*probsSelfExcitePtr), result, buffer);
     }
 
     void setParameters(double* data, size_t length) {
         assert(length == 6);
+        // Per-event rates depend on the kernel parameters only; theta and mu0 enter linearly
+        if (data[0] != sigmaXprec || data[1] != tauXprec || data[2] != tauTprec || data[3] != omega) {
+            ratesKnown = false;
+        }
+        if (data[0] != sigmaXprec || data[1] != tauXprec || data[2] != tauTprec || data[3] != omega ||
+            data[4] != theta || data[5] != mu0) {
+            ++version.parameters;
+        }
         sigmaXprec = data[0];
         tauXprec = data[1];
         tauTprec = data[2];
@@ -338,12 +645,321 @@ public:
         mu0 = data[5];
     }
 
+    void getSumOfLikContribsBatch(const double* parameters, int count, double* logLikelihoods, double* gradients) {
+        computeBatchGeneric<typename TypeInfo::SimdType, TypeInfo::SimdSize>(parameters, count,
+                                                                             logLikelihoods, gradients);
+    }
+
+    static KernelParameters makeKernelParameters(const double* data) {
+        return KernelParameters{ data[0], data[1], data[2], data[3], data[4], data[5] };
+    }
+
+    KernelParameters getKernelParameters() const {
+        return KernelParameters{ sigmaXprec, tauXprec, tauTprec, omega, theta, mu0 };
+    }
+
+    void setTruncation(double tolerance) {
+        assert(tolerance >= 0.0 && tolerance < 1.0);
+        if (tolerance != truncationTolerance) {
+            truncationTolerance = tolerance;
+            ratesKnown = false;
+            storedRatesKnown = false;
+            storedLikelihoodKnown = false;
+            ++version.parameters; // Truncated results depend on the tolerance
+        }
+    }
+
+    double getTruncationErrorBound() {
+        return truncationErrorBound;
+    }
+
+    std::size_t getDistanceCacheFootprint() {
+        return (flags & hph::Flags::DISTANCE_CACHE) ?
+               DistanceCache<RealType>::footprint(locationCount, getCacheStorage()) : 0;
+    }
+
+    void limitThreads(bool limit) {
+#ifdef USE_TBB
+        control.reset();
+        if (limit && (flags & hph::Flags::TBB)) {
+            control = std::make_shared<tbb::global_control>(tbb::global_control::max_allowed_parallelism, nThreads);
+        }
+#endif
+    }
+
+    std::shared_ptr<AbstractHawkes> clone() {
+        // Build once, before they are shared; the cut-offs need the kernel parameters
+        updateDistanceCache();
+        if (sigmaXprec > 0.0 && tauXprec > 0.0 && tauTprec > 0.0 && omega > 0.0) {
+            updateSpatialIndex();
+            updateNeighbourList();
+        }
+        return std::make_shared<NewHawkes>(*this);
+    }
+
+    void appendEvents(double* newTimes, double* newLocations, size_t count) {
+
+        if (!std::is_sorted(newTimes, newTimes + count) ||
+            (count > 0 && locationCount > 0 && static_cast<RealType>(newTimes[0]) < times[locationCount - 1])) {
+#ifdef RBUILD
+            Rcpp::stop("Appended event times must be sorted and not before the last event");
+#else
+            std::cerr << "Appended event times must be sorted and not before the last event" << std::endl;
+            exit(-1);
+#endif
+        }
+
+        if (windowLength > 0.0 && count > 0) {
+            evictEvents(newTimes[count - 1] - windowLength);
+        }
+
+        const int oldCount = locationCount;
+        const double oldEnd = oldCount > 0 ? times[oldCount - 1] : 0.0;
+
+        locationCount += static_cast<int>(count);
+        observationCount = locationCount * (locationCount - 1) / 2;
+
+        auto& timesStore = times.modify();
+        mm::grow(timesStore, locationCount);
+        mm::bufferedCopy(newTimes, newTimes + count, begin(timesStore) + oldCount, buffer);
+
+        *storedLocationsPtr = mm::SharedMemoryManager<RealType>(); // Drop the stored share so growing does not copy
+        auto& locationsStore = locationsPtr->modify();
+        mm::grow(locationsStore, locationCount * embeddingDimension);
+        mm::bufferedCopy(newLocations, newLocations + count * embeddingDimension,
+                         begin(locationsStore) + oldCount * embeddingDimension, buffer);
+        *storedLocationsPtr = *locationsPtr;
+
+        mm::grow(backgroundRates, locationCount);
+        mm::grow(selfExciteRates, locationCount);
+        mm::grow(probsSelfExcite, locationCount);
+        mm::grow(likContribs, locationCount);
+        mm::grow(storedLikContribs, locationCount);
+        mm::grow(skippedCounts, locationCount);
+
+        invalidateSpatialIndex();
+        neighbourListKnown = false;
+        distanceCacheKnown = false;
+        storedRatesKnown = false;
+        storedLikelihoodKnown = false;
+        ++version.times;
+        ++version.locations;
+
+        if (ratesKnown && oldCount > 0) {
+            appendRates<typename TypeInfo::SimdType, TypeInfo::SimdSize, Generic>(oldCount, oldEnd);
+        } else {
+            ratesKnown = false;
+        }
+    }
+
+    void setWindow(double length) {
+        assert(length >= 0.0);
+        windowLength = length;
+        if (windowLength > 0.0 && locationCount > 0) {
+            evictEvents(times[locationCount - 1] - windowLength);
+        }
+    }
+
+    // Drops all events before time cutoff, subtracting their contributions from cached rates
+    void evictEvents(const double cutoff) {
+
+        const auto first = std::begin(times);
+        const int evicted = static_cast<int>(std::lower_bound(first, first + locationCount,
+                static_cast<RealType>(cutoff)) - first);
+        if (evicted == 0) {
+            return;
+        }
+
+        if (ratesKnown) {
+            evictRates<typename TypeInfo::SimdType, TypeInfo::SimdSize, Generic>(evicted);
+        }
+
+        const int remaining = locationCount - evicted;
+        auto compact = [evicted, remaining](auto& store, const int stride) {
+            std::copy(std::begin(store) + evicted * stride, std::begin(store) + (evicted + remaining) * stride,
+                      std::begin(store));
+            store.resize(remaining * stride);
+        };
+
+        compact(times.modify(), 1);
+        *storedLocationsPtr = mm::SharedMemoryManager<RealType>(); // Drop the stored share so compacting does not copy
+        compact(locationsPtr->modify(), embeddingDimension);
+        *storedLocationsPtr = *locationsPtr;
+
+        compact(backgroundRates, 1);
+        compact(selfExciteRates, 1);
+        compact(skippedCounts, 1);
+        compact(probsSelfExcite, 1);
+        likContribs.resize(remaining);
+        storedLikContribs.resize(remaining);
+
+        locationCount = remaining;
+        observationCount = locationCount * (locationCount - 1) / 2;
+
+        invalidateSpatialIndex();
+        neighbourListKnown = false;
+        distanceCacheKnown = false;
+        storedRatesKnown = false;
+        storedLikelihoodKnown = false;
+        ++version.times;
+        ++version.locations;
+
+        if (locationCount == 0) {
+            ratesKnown = false;
+        }
+    }
+
+    void evaluateIntensity(double* queryLocations, double* queryTimes, size_t count,
+                           double* intensity, double* background, double* selfExcite) {
+        evaluateIntensityGeneric<typename TypeInfo::SimdType, TypeInfo::SimdSize, Generic>(
+                queryLocations, queryTimes, count, intensity, background, selfExcite);
+    }
+
+    void evaluateCompensator(double* lower, double* upper, double* startTimes, double* endTimes, size_t count,
+                             double* expected, double* background, double* selfExcite) {
+        evaluateCompensatorGeneric<typename TypeInfo::SimdType, TypeInfo::SimdSize>(
+                lower, upper, startTimes, endTimes, count, expected, background, selfExcite);
+    }
+
+    // Snapshot sections, in file order
+    enum StateSection {
+        StateScalars, StateKnown, StateTimes, StateLocations, StateStoredLocations, StateBackgroundRates,
+        StateSelfExciteRates, StateSkippedCounts, StateProbsSelfExcite, StateGradient, StateExtra
+    };
+
+    void saveState(const std::string& path, const double* extra, size_t extraLength) {
+
+        const double scalars[] = {
+                sigmaXprec, tauXprec, tauTprec, omega, theta, mu0,
+                storedSigmaXprec, storedTauXprec, storedTauTprec, storedOmega, storedTheta, storedMu0,
+                sumOfLikContribs, storedSumOfLikContribs, backgroundIntegral, selfExciteDecay,
+                truncationTolerance, truncationErrorBound, windowLength
+        };
+
+        const int known[] = {
+                ratesKnown, likelihoodVersion == version, storedLikelihoodKnown,
+                probsVersion == version, gradientVersion == version
+        };
+
+        // Stored locations usually share the current ones; an empty section records that
+        const bool storedShared = storedLocationsPtr->data() == locationsPtr->data();
+
+        StateFileWriter writer(embeddingDimension, locationCount, sizeof(RealType));
+        writer.add(scalars, sizeof(scalars) / sizeof(double));
+        writer.add(known, sizeof(known) / sizeof(int));
+        writer.add(times.data(), locationCount);
+        writer.add(locationsPtr->data(), locationCount * embeddingDimension);
+        writer.add(storedLocationsPtr->data(), storedShared ? 0 : storedLocationsPtr->size());
+        writer.add(backgroundRates.data(), locationCount);
+        writer.add(selfExciteRates.data(), locationCount);
+        writer.add(skippedCounts.data(), locationCount);
+        writer.add(probsSelfExcite.data(), locationCount);
+        writer.add(gradientPtr->data(), gradientPtr->size());
+        writer.add(extra, extra != nullptr ? extraLength : 0);
+        writer.write(path);
+    }
+
+    void loadState(const std::string& path, std::vector<double>* extra) {
+
+        MappedStateFile file(path);
+        if (file.getEmbeddingDimension() != embeddingDimension || file.getRealSize() != sizeof(RealType)) {
+            statefile::fail("State file " + path + " was saved by an engine of another dimension or precision");
+        }
+
+        locationCount = file.getLocationCount();
+        observationCount = locationCount * (locationCount - 1) / 2;
+        const std::size_t length = locationCount * embeddingDimension;
+
+        const double* scalars = file.get<double>(StateScalars, 19);
+        sigmaXprec = scalars[0];
+        tauXprec = scalars[1];
+        tauTprec = scalars[2];
+        omega = scalars[3];
+        theta = scalars[4];
+        mu0 = scalars[5];
+        storedSigmaXprec = scalars[6];
+        storedTauXprec = scalars[7];
+        storedTauTprec = scalars[8];
+        storedOmega = scalars[9];
+        storedTheta = scalars[10];
+        storedMu0 = scalars[11];
+        sumOfLikContribs = scalars[12];
+        storedSumOfLikContribs = scalars[13];
+        backgroundIntegral = scalars[14];
+        selfExciteDecay = scalars[15];
+        truncationTolerance = scalars[16];
+        truncationErrorBound = scalars[17];
+        windowLength = scalars[18];
+
+        auto assign = [&file](auto& store, const int section, const std::size_t count) {
+            using Element = typename std::decay<decltype(store)>::type::value_type;
+            const Element* data = file.template get<Element>(section, count);
+            store.assign(data, data + count);
+        };
+
+        assign(times.modify(), StateTimes, locationCount);
+        assign(locationsPtr->modify(), StateLocations, length);
+        if (file.getLength<RealType>(StateStoredLocations) == 0) {
+            *storedLocationsPtr = *locationsPtr;
+        } else {
+            *storedLocationsPtr = mm::SharedMemoryManager<RealType>();
+            assign(storedLocationsPtr->modify(), StateStoredLocations, length);
+        }
+        assign(backgroundRates, StateBackgroundRates, locationCount);
+        assign(selfExciteRates, StateSelfExciteRates, locationCount);
+        assign(skippedCounts, StateSkippedCounts, locationCount);
+        assign(probsSelfExcite, StateProbsSelfExcite, locationCount);
+        assign(*gradientPtr, StateGradient, file.getLength<RealType>(StateGradient));
+
+        likContribs.resize(locationCount);
+        storedLikContribs.resize(locationCount);
+
+        if (extra != nullptr) {
+            const std::size_t extraLength = file.getLength<double>(StateExtra);
+            const double* data = file.get<double>(StateExtra, extraLength);
+            extra->assign(data, data + extraLength);
+        }
+
+        invalidateSpatialIndex();
+        neighbourListKnown = false;
+        distanceCacheKnown = false;
+
+        const int* known = file.get<int>(StateKnown, 5);
+        ratesKnown = known[0] != 0;
+        storedRatesKnown = false;
+        storedLikelihoodKnown = known[2] != 0;
+
+        ++version.parameters;
+        ++version.times;
+        ++version.locations;
+        likelihoodVersion = known[1] ? version : StateVersion{0, 0, 0};
+        probsVersion = known[3] ? version : StateVersion{0, 0, 0};
+        gradientVersion = known[4] ? version : StateVersion{0, 0, 0};
+    }
+
 	void getLogLikelihoodGradient(double* result, size_t length) {
 		assert (length == 6);
-		computeLogLikelihoodGradientGeneric<typename TypeInfo::SimdType, TypeInfo::SimdSize, Generic>();
+		if (gradientVersion != version) {
+		    computeLogLikelihoodGradientGeneric<typename TypeInfo::SimdType, TypeInfo::SimdSize, Generic>();
+		    gradientVersion = version;
+		}
 		mm::bufferedCopy(std::begin(*gradientPtr), std::end(*gradientPtr), result, buffer);
     }
 
+    void evaluateAll(double* logLikelihood, double* gradient, double* probsSelfExcite) {
+
+        // The gradient pass leaves the per-event rates cached, so the rest is O(N)
+        if (gradient != nullptr) {
+            getLogLikelihoodGradient(gradient, 6);
+        }
+
+        *logLikelihood = getSumOfLikContribs();
+
+        if (probsSelfExcite != nullptr) {
+            getProbsSelfExcite(probsSelfExcite, locationCount);
+        }
+    }
+
 	template <typename SimdType, int SimdSize, typename Algorithm>
     RealType computeLogLikelihoodGradientGeneric() {
 
@@ -352,51 +968,44 @@ public:
             gradientPtr->resize(length);
         }
 
+        const auto kernel = getKernelParameters();
         const auto sigmaXprecD = pow(sigmaXprec, embeddingDimension);
         const auto tauXprecD = pow(tauXprec, embeddingDimension);
         const auto tauTprec2 = tauTprec * tauTprec;
+        const auto backgroundScale = tauXprecD * tauTprec;
+        const auto selfExciteScale = sigmaXprecD * omega;
+
+        updatePairStructures();
 
         const auto grad =
                 accumulate(0, locationCount, RealTypePack<7>(0.0), [this,
+                                                                    &kernel,
                                                                     sigmaXprecD,
                                                                     tauXprecD,
-                                                                    tauTprec2](const int i) {
-
-                    const int vectorCount = locationCount - locationCount % SimdSize;
-
-                    DistanceDispatch<SimdType, RealType, Algorithm> dispatch(*locationsPtr, i, embeddingDimension);
-                    auto sumOfRates = innerLoop1<SimdType, SimdSize, 7>(dispatch, i, 0, vectorCount,
-                            sigmaXprecD, tauXprecD, tauTprec2);
-
-                    if (vectorCount < locationCount) { // Edge-cases
-                        DistanceDispatch<RealType, RealType, Algorithm> dispatch(*locationsPtr, i, embeddingDimension);
-                        sumOfRates += innerLoop1<RealType, 1, 7>(dispatch, i, vectorCount, locationCount,
-                                sigmaXprecD, tauXprecD, tauTprec2);
-                    }
+                                                                    tauTprec2,
+                                                                    backgroundScale,
+                                                                    selfExciteScale](const int i) {
 
-                    auto const timDiff = times[locationCount-1]-times[i];
-                    auto const expOmegaTimDiff = adhoc::exp(-omega*timDiff);
+                    auto sumOfRates = reduceRow<SimdType, SimdSize, Algorithm, RealTypePack<7>>(i,
+                            [this, i, &kernel, sigmaXprecD, tauXprecD, tauTprec2](auto info, const auto& dispatch,
+                                                                                 const RealType* timesJ,
+                                                                                 const int begin, const int end) {
+                        using Info = decltype(info);
+                        return this->template innerLoop1<typename Info::SimdType, Info::SimdSize, 7>(
+                                dispatch, timesJ, i, begin, end, sigmaXprecD, tauXprecD, tauTprec2, kernel);
+                    });
 
-                    sumOfRates[0] /= sumOfRates[6];
-                    sumOfRates[1] /= sumOfRates[6];
-                    sumOfRates[2] = sumOfRates[2]/sumOfRates[6] * tauXprecD +
-                            adhoc::pdf_new(tauTprec * timDiff) * timDiff + adhoc::pdf_new(tauTprec*times[i])*times[i];
-                    sumOfRates[3] = (1-(1+omega*timDiff) * expOmegaTimDiff)/(omega*omega) - sumOfRates[3]/sumOfRates[6] * sigmaXprecD;
-                    sumOfRates[4] = sumOfRates[4]/sumOfRates[6] * sigmaXprecD + (expOmegaTimDiff-1)/omega;
-                    sumOfRates[5] = sumOfRates[5]/sumOfRates[6] * tauXprecD * tauTprec -
-                            (adhoc::exp(math::phi_new(tauTprec*timDiff)) - adhoc::exp(math::phi_new(tauTprec*(-times[i]))));
-                    sumOfRates[6] = std::log(sumOfRates[6]);
+                    backgroundRates[i] = sumOfRates[5] * backgroundScale;
+                    selfExciteRates[i] = sumOfRates[4] * selfExciteScale;
 
-                    return sumOfRates;
+                    return finishGradientRow(sumOfRates, i, kernel, sigmaXprecD, tauXprecD);
 
                 }, ParallelType());
 
-        (*gradientPtr)[0] = grad[0] * theta * sigmaXprecD * sigmaXprec;        //sigmaX
-        (*gradientPtr)[1] = grad[1] * mu0 * tauXprecD * tauXprec * tauTprec;   //tauX
-        (*gradientPtr)[2] = grad[2] * mu0 * tauTprec2;                         //tauT
-        (*gradientPtr)[3] = grad[3] * theta;                                   //omega
-        (*gradientPtr)[4] = grad[4];                                           //theta
-        (*gradientPtr)[5] = grad[5];                                           //mu0
+        scaleGradient(grad, kernel, sigmaXprecD, tauXprecD, &(*gradientPtr)[0]);
+
+        computeIntegrals();
+        ratesKnown = true;
 
         return grad[6]; // TODO log-likelihood
     }
@@ -449,9 +1058,16 @@ public:
 	using D4 = xsimd::batch<double, 4>;
 	using D4Bool = xsimd::batch_bool<double, 4>;
 
+	using S8 = xsimd::batch<float, 8>;
+	using S8Bool = xsimd::batch_bool<float, 8>;
+
 	D4 getIota(D4) {
         return D4(0, 1, 2, 3);
     }
+
+    S8 getIota(S8) {
+        return S8(0, 1, 2, 3, 4, 5, 6, 7);
+    }
 #endif
 
 #ifdef USE_AVX512
@@ -465,6 +1081,17 @@ public:
 	D8 mask(D8Bool flag, D8 x) {
 		return xsimd::select(flag, x, D8(0.0)); // bitwise & does not appear to work
     }
+
+    using S16 = xsimd::batch<float, 16>;
+    using S16Bool = xsimd::batch_bool<float, 16>;
+
+    S16 getIota(S16) {
+        return S16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    }
+
+    S16 mask(S16Bool flag, S16 x) {
+        return xsimd::select(flag, x, S16(0.0f)); // AVX-512 comparisons yield mask registers, as for D8
+    }
 #endif
 
     template <typename T>
@@ -482,6 +1109,23 @@ public:
         return x;
     }
 
+    // Sum of lanes in SumType
+    template <typename T>
+    SumType reduceWide(T x) {
+        return x;
+    }
+
+#ifdef USE_SIMD
+    template <typename T, size_t N>
+    SumType reduceWide(SimdBatch<T, N> x) {
+        SumType sum = 0;
+        for (size_t k = 0; k < N; ++k) {
+            sum += x[k];
+        }
+        return sum;
+    }
+#endif
+
 	bool any(bool x) {
 		return x;
 	}
@@ -499,6 +1143,10 @@ public:
 	double getScalar(D4 x, int i) {
 		return x[i];
 	}
+
+	float getScalar(S8 x, int i) {
+		return x[i];
+	}
 #endif
 #ifdef USE_SSE
 	double getScalar(D2 x, int i) {
@@ -515,41 +1163,16 @@ public:
     double getScalar(D8 x, int i) {
 	    return x[i];
 	}
-#endif
-
-    template <typename SimdType, int SimdSize, typename DispatchType>
-    RealType ratesLoop(const DispatchType& dispatch, const int i, const int begin, const int end) {
-
-        auto sum = SimdType(RealType(0));
-        const auto zero = SimdType(RealType(0));
-
-        const auto tauXprecD = pow(tauXprec, embeddingDimension);
-        const auto sigmaXprecD = pow(sigmaXprec, embeddingDimension);
-        const auto mu0TauXprecDTauTprec = mu0 * tauXprecD * tauTprec;
-        const auto sigmaXprecDThetaOmega = sigmaXprecD * theta * omega;
-
-        const auto timeI = SimdType(RealType(times[i]));
-
-        for (int j = begin; j < end; j += SimdSize) {
-
-            const auto locDist = dispatch.calculate(j); //SimdHelper<SimdType, RealType>::get(&locDists[i * locationCount + j]);
-            const auto timDiff = timeI - SimdHelper<SimdType, RealType>::get(&times[j]);
-
-            const auto rate =  mu0TauXprecDTauTprec *
-                    adhoc::pdf_new(locDist * tauXprec) * adhoc::pdf_new(timDiff * tauTprec) +
-                    sigmaXprecDThetaOmega * mask(timDiff > zero,
-                         adhoc::exp(-omega * timDiff) * adhoc::pdf_new(locDist * sigmaXprec));
 
-            sum += rate;
-        }
-
-        return reduce(sum);
-    }
+    float getScalar(S16 x, int i) {
+	    return x[i];
+	}
+#endif
 
     template <int N>
 	class RealTypePack {
 	public:
-	    RealTypePack(RealType x) {
+	    RealTypePack(SumType x) {
 	        pack.fill(x);
 	    }
 
@@ -566,16 +1189,45 @@ public:
 	        return result;
 	    }
 
-	    RealType& operator[](std::size_t i) {
+	    SumType& operator[](std::size_t i) {
 	        return pack[i];
 	    }
 
-	    const RealType& operator[](std::size_t i) const {
+	    const SumType& operator[](std::size_t i) const {
 	        return pack[i];
 	    }
 
 	private:
-	    std::array<RealType, N> pack;
+	    std::array<SumType, N> pack;
+	};
+
+	class RealTypeVector {
+	public:
+	    RealTypeVector(std::size_t size, SumType x) : values(size, x) { }
+
+	    RealTypeVector& operator+=(const RealTypeVector& rhs) {
+	        for (std::size_t i = 0; i < values.size(); ++i) {
+	            values[i] += rhs[i];
+	        }
+	        return *this;
+	    }
+
+	    const RealTypeVector operator+(const RealTypeVector& rhs) const {
+	        RealTypeVector result = *this;
+	        result += rhs;
+	        return result;
+	    }
+
+	    SumType& operator[](std::size_t i) {
+	        return values[i];
+	    }
+
+	    const SumType& operator[](std::size_t i) const {
+	        return values[i];
+	    }
+
+	private:
+	    mm::MemoryManager<SumType> values;
 	};
 
 	template <typename SimdType, int N>
@@ -589,37 +1241,76 @@ public:
 	    return pack;
 	}
 
-    template <typename SimdType, int SimdSize, int N, typename DispatchType>
-    RealTypePack<N> innerLoop1(const DispatchType& dispatch, const int i, const int begin, const int end,
-            const RealType sigmaXprecD, const RealType tauXprecD, const RealType tauTprec2) {
+	template <typename SimdType, int N>
+	RealTypePack<N> reduce(const std::array<CompensatedSum<SimdType>, N> rhs) {
+
+	    RealTypePack<N> pack(0.0);
+	    for (int i = 0; i < N; ++i) {
+	        pack[i] = reduceWide(rhs[i].sum) - reduceWide(rhs[i].compensation);
+	    }
 
-        const auto sigmaXprec2 = sigmaXprec * sigmaXprec;
-        const auto tauXprec2 = tauXprec * tauXprec;
-        const auto mu0TauXprecDTauTprec = mu0 * tauXprecD * tauTprec;
-        const auto sigmaXprecDTheta = sigmaXprecD * theta;
+	    return pack;
+	}
 
-		const auto zero = SimdType(RealType(0));
-		std::array<SimdType, N> sum = {zero, zero, zero, zero, zero, zero, zero};
+    template <typename SimdType, int SimdSize, typename DispatchType>
+    RealTypePack<2> ratesLoop(const DispatchType& dispatch, const RealType* timesJ,
+                              const RealType time, const int begin, const int end, const KernelParameters& p) {
 
-        const auto timeI = SimdType(RealType(times[i]));
+        const auto zero = SimdType(RealType(0));
+        std::array<LaneSum<SimdType>, 2> sum = {LaneSum<SimdType>(zero), LaneSum<SimdType>(zero)};
+
+        const auto timeI = SimdType(time);
 
         for (int j = begin; j < end; j += SimdSize) {
-            const auto locDist = dispatch.calculate(j);//SimdHelper<SimdType, RealType>::get(&locDists[i * locationCount + j]);
-            const auto timDiff = timeI - SimdHelper<SimdType, RealType>::get(&times[j]);
 
-            const auto pdfLocDistSigmaXPrec = adhoc::pdf_new(locDist * sigmaXprec);
-            const auto pdfLocDistTauXPrec = adhoc::pdf_new(locDist * tauXprec);
-            const auto pdfTimDiffTauTPrec = adhoc::pdf_new(timDiff * tauTprec);
-            const auto expOmegaTimDiff = adhoc::exp(-omega*timDiff);
+            const auto locDist = dispatch.calculate(j); //SimdHelper<SimdType, RealType>::get(&locDists[i * locationCount + j]);
+            const auto timDiff = timeI - SimdHelper<SimdType, RealType>::get(timesJ + j);
 
-            const auto mu0Rate = pdfLocDistTauXPrec * pdfTimDiffTauTPrec;
-            const auto thetaRate = mask(timDiff > zero, expOmegaTimDiff * pdfLocDistSigmaXPrec);
+            const auto background = adhoc::pdf_new(locDist * p.tauXprec) * adhoc::pdf_new(timDiff * p.tauTprec);
+            const auto selfexcite = mask(timDiff > zero,
+                                         adhoc::exp(-p.omega * timDiff) * adhoc::pdf_new(locDist * p.sigmaXprec));
 
-            const auto sigmaXrate = (sigmaXprec2*locDist*locDist - embeddingDimension) * thetaRate;
-            const auto tauXrate = (tauXprec2 * locDist * locDist - embeddingDimension) * mu0Rate;
-            const auto tauTrate = (tauTprec2 * timDiff * timDiff - 1) * mu0Rate;
+            sum[0] += background;
+            sum[1] += selfexcite;
+        }
+
+        return reduce<SimdType,2>(sum);
+    }
+
+    template <typename SimdType, int SimdSize, int N, typename DispatchType>
+    RealTypePack<N> innerLoop1(const DispatchType& dispatch, const RealType* timesJ,
+            const int i, const int begin, const int end,
+            const RealType sigmaXprecD, const RealType tauXprecD, const RealType tauTprec2,
+            const KernelParameters& p) {
+
+        const auto sigmaXprec2 = p.sigmaXprec * p.sigmaXprec;
+        const auto tauXprec2 = p.tauXprec * p.tauXprec;
+        const auto mu0TauXprecDTauTprec = p.mu0 * tauXprecD * p.tauTprec;
+        const auto sigmaXprecDThetaOmega = sigmaXprecD * p.theta * p.omega;
+
+		const auto zero = SimdType(RealType(0));
+		const auto empty = LaneSum<SimdType>(zero);
+		std::array<LaneSum<SimdType>, N> sum = {empty, empty, empty, empty, empty, empty, empty};
+
+        const auto timeI = SimdType(RealType(times[i]));
+
+        for (int j = begin; j < end; j += SimdSize) {
+            const auto locDist = dispatch.calculate(j);//SimdHelper<SimdType, RealType>::get(&locDists[i * locationCount + j]);
+            const auto timDiff = timeI - SimdHelper<SimdType, RealType>::get(timesJ + j);
+
+            const auto pdfLocDistSigmaXPrec = adhoc::pdf_new(locDist * p.sigmaXprec);
+            const auto pdfLocDistTauXPrec = adhoc::pdf_new(locDist * p.tauXprec);
+            const auto pdfTimDiffTauTPrec = adhoc::pdf_new(timDiff * p.tauTprec);
+            const auto expOmegaTimDiff = adhoc::exp(-p.omega*timDiff);
+
+            const auto mu0Rate = pdfLocDistTauXPrec * pdfTimDiffTauTPrec;
+            const auto thetaRate = mask(timDiff > zero, expOmegaTimDiff * pdfLocDistSigmaXPrec);
+
+            const auto sigmaXrate = (sigmaXprec2*locDist*locDist - embeddingDimension) * thetaRate;
+            const auto tauXrate = (tauXprec2 * locDist * locDist - embeddingDimension) * mu0Rate;
+            const auto tauTrate = (tauTprec2 * timDiff * timDiff - 1) * mu0Rate;
             const auto omegaRate = timDiff * thetaRate;
-            const auto totalRate = mu0TauXprecDTauTprec * mu0Rate + sigmaXprecDTheta * thetaRate;
+            const auto totalRate = mu0TauXprecDTauTprec * mu0Rate + sigmaXprecDThetaOmega * thetaRate;
 
             sum[0] += sigmaXrate;
             sum[1] += tauXrate;
@@ -633,94 +1324,994 @@ public:
         return reduce<SimdType,N>(sum);
 	}
 
-    template <typename SimdType, int SimdSize, typename Algorithm>
-    RealType computeSumOfLikContribsGeneric() {
+    RealTypePack<7> finishGradientRow(RealTypePack<7> sumOfRates, const int i, const KernelParameters& p,
+                                      const double sigmaXprecD, const double tauXprecD) const {
+
+        const auto omega = p.omega;
+        const auto tauTprec = p.tauTprec;
+
+        auto const timDiff = times[locationCount-1]-times[i];
+        auto const expOmegaTimDiff = adhoc::exp(-omega*timDiff);
+
+        sumOfRates[0] /= sumOfRates[6];
+        sumOfRates[1] /= sumOfRates[6];
+        sumOfRates[2] = sumOfRates[2]/sumOfRates[6] * tauXprecD +
+                adhoc::pdf_new(tauTprec * timDiff) * timDiff + adhoc::pdf_new(tauTprec*times[i])*times[i];
+        sumOfRates[3] = (sumOfRates[4] - omega * sumOfRates[3])/sumOfRates[6] * sigmaXprecD - timDiff * expOmegaTimDiff;
+        sumOfRates[4] = sumOfRates[4]/sumOfRates[6] * sigmaXprecD * omega + (expOmegaTimDiff-1);
+        sumOfRates[5] = sumOfRates[5]/sumOfRates[6] * tauXprecD * tauTprec -
+                (adhoc::exp(math::phi_new(tauTprec*timDiff)) - adhoc::exp(math::phi_new(tauTprec*(-times[i]))));
+        sumOfRates[6] = std::log(sumOfRates[6]);
+
+        return sumOfRates;
+    }
+
+    template <typename PackType, typename ResultType>
+    void scaleGradient(const PackType& grad, const KernelParameters& p,
+                       const double sigmaXprecD, const double tauXprecD, ResultType* result) const {
+        result[0] = grad[0] * p.theta * sigmaXprecD * p.sigmaXprec * p.omega;   //sigmaX
+        result[1] = grad[1] * p.mu0 * tauXprecD * p.tauXprec * p.tauTprec;      //tauX
+        result[2] = grad[2] * p.mu0 * p.tauTprec * p.tauTprec;                  //tauT
+        result[3] = grad[3] * p.theta;                                          //omega
+        result[4] = grad[4];                                                    //theta
+        result[5] = grad[5];                                                    //mu0
+    }
+
+    // Evaluates K parameter sets in one sweep: distances for row i are computed (or decoded) once over
+    // the union of the K truncation windows and reused by every set
+    template <typename SimdType, int SimdSize>
+    void computeBatchGeneric(const double* parameters, const int count,
+                             double* logLikelihoods, double* gradients) {
+
+        mm::MemoryManager<KernelParameters> kernels(count);
+        double backgroundLag = 0.0;
+        double selfExciteLag = 0.0;
+        for (int k = 0; k < count; ++k) {
+            kernels[k] = makeKernelParameters(parameters + 6 * k);
+            if (truncationTolerance > 0.0) {
+                const auto logTolerance = std::log(truncationTolerance);
+                backgroundLag = std::max(backgroundLag, std::sqrt(-2.0 * logTolerance) / kernels[k].tauTprec);
+                selfExciteLag = std::max(selfExciteLag, -logTolerance / kernels[k].omega);
+            }
+        }
 
-        RealType delta =
-                accumulate(0, locationCount, RealType(0), [this](const int i) {
+        if (flags & hph::Flags::DISTANCE_CACHE) {
+            updateDistanceCache();
+        }
 
-                    const int vectorCount = locationCount - locationCount % SimdSize;
+        const bool withGradient = gradients != nullptr;
+        const int stride = withGradient ? 7 : 1;
 
-                    DistanceDispatch<SimdType, RealType, Algorithm> dispatch(*locationsPtr, i, embeddingDimension);
-					RealType sumOfRates = ratesLoop<SimdType, SimdSize>(dispatch, i, 0, vectorCount);
+        mm::MemoryManager<double> sigmaXprecD(count);
+        mm::MemoryManager<double> tauXprecD(count);
+        for (int k = 0; k < count; ++k) {
+            sigmaXprecD[k] = pow(kernels[k].sigmaXprec, embeddingDimension);
+            tauXprecD[k] = pow(kernels[k].tauXprec, embeddingDimension);
+        }
 
-                    if (vectorCount < locationCount) { // Edge-cases
-                        DistanceDispatch<RealType, RealType, Algorithm> dispatch(*locationsPtr, i, embeddingDimension);
-                        sumOfRates += ratesLoop<RealType, 1>(dispatch, i, vectorCount, locationCount);
+        const auto total =
+                accumulate(0, locationCount, RealTypeVector(count * stride, 0.0), [&](const int i) {
+
+                    const auto window = truncationTolerance > 0.0 ?
+                                        getWindow(i, backgroundLag, selfExciteLag) :
+                                        std::make_pair(0, locationCount);
+                    const int begin = window.first;
+                    const int length = window.second - begin;
+                    const int vectorCount = length - length % SimdSize;
+
+                    static thread_local mm::MemoryManager<RealType> distances;
+                    distances.resize(length);
+                    fillDistances<SimdType, SimdSize>(i, begin, window.second, distances.data());
+
+                    const RealType* timesJ = &times[begin];
+                    StreamDispatch<SimdType, RealType> dispatch(distances.data());
+                    StreamDispatch<RealType, RealType> scalarDispatch(distances.data());
+
+                    RealTypeVector row(count * stride, 0.0);
+
+                    for (int k = 0; k < count; ++k) {
+                        const auto& p = kernels[k];
+                        const auto timDiff = times[locationCount - 1] - times[i];
+                        const auto integrals = p.theta * (adhoc::exp(-p.omega * timDiff) - 1) -
+                                p.mu0 * (adhoc::exp(math::phi_new(p.tauTprec * timDiff)) -
+                                         adhoc::exp(math::phi_new(p.tauTprec * (-times[i]))));
+
+                        if (withGradient) {
+                            const auto tauTprec2 = p.tauTprec * p.tauTprec;
+                            auto sums = innerLoop1<SimdType, SimdSize, 7>(dispatch, timesJ, i, 0, vectorCount,
+                                    sigmaXprecD[k], tauXprecD[k], tauTprec2, p);
+                            if (vectorCount < length) { // Edge-cases
+                                sums += innerLoop1<RealType, 1, 7>(scalarDispatch, timesJ, i, vectorCount, length,
+                                        sigmaXprecD[k], tauXprecD[k], tauTprec2, p);
+                            }
+
+                            const auto rate = p.mu0 * tauXprecD[k] * p.tauTprec * sums[5] +
+                                              p.theta * sigmaXprecD[k] * p.omega * sums[4];
+                            const auto gradient = finishGradientRow(sums, i, p, sigmaXprecD[k], tauXprecD[k]);
+
+                            row[k * stride] = std::log(rate) + integrals;
+                            for (int m = 0; m < 6; ++m) {
+                                row[k * stride + 1 + m] = gradient[m];
+                            }
+                        } else {
+                            auto sums = ratesLoop<SimdType, SimdSize>(dispatch, timesJ, times[i], 0, vectorCount, p);
+                            if (vectorCount < length) { // Edge-cases
+                                sums += ratesLoop<RealType, 1>(scalarDispatch, timesJ, times[i], vectorCount, length, p);
+                            }
+
+                            const auto rate = p.mu0 * tauXprecD[k] * p.tauTprec * sums[0] +
+                                              p.theta * sigmaXprecD[k] * p.omega * sums[1];
+
+                            row[k * stride] = std::log(rate) + integrals;
+                        }
                     }
 
-                    return xsimd::log(sumOfRates) +
-                           theta * (adhoc::exp(-omega * (times[locationCount - 1] - times[i])) - 1) -
-                           mu0 * (adhoc::exp(math::phi_new(tauTprec * (times[locationCount - 1] - times[i]))) -
-                                adhoc::exp(math::phi_new(tauTprec * (-times[i]))));
+                    return row;
 
                 }, ParallelType());
 
-        return delta + locationCount * (embeddingDimension - 1) * log(M_1_SQRT_2PI);
+        const auto normalization = locationCount * (embeddingDimension - 1) * log(M_1_SQRT_2PI);
+
+        for (int k = 0; k < count; ++k) {
+            logLikelihoods[k] = total[k * stride] + normalization;
+            if (withGradient) {
+                RealTypePack<6> grad(0.0);
+                for (int m = 0; m < 6; ++m) {
+                    grad[m] = total[k * stride + 1 + m];
+                }
+                scaleGradient(grad, kernels[k], sigmaXprecD[k], tauXprecD[k], gradients + 6 * k);
+            }
+        }
     }
 
-    template <typename SimdType, int SimdSize, typename Algorithm>
-    void computeProbsSelfExcite() {
+    template <typename SimdType, int SimdSize>
+    void fillDistances(const int i, const int begin, const int end, RealType* out) {
 
-        const auto length = locationCount;
-        if (length != probsSelfExcitePtr->size()) {
-            probsSelfExcitePtr->resize(length);
+        if (flags & hph::Flags::DISTANCE_CACHE) {
+            distanceCache->decodeRow(i, begin, end, out);
+            return;
+        }
+
+        const int vectorEnd = end - (end - begin) % SimdSize;
+
+        DistanceDispatch<SimdType, RealType, Generic> dispatch(locationsPtr->data(), i, embeddingDimension);
+        for (int j = begin; j < vectorEnd; j += SimdSize) {
+            SimdHelper<SimdType, RealType>::put(dispatch.calculate(j), out + (j - begin));
+        }
+
+        DistanceDispatch<RealType, RealType, Generic> scalarDispatch(locationsPtr->data(), i, embeddingDimension);
+        for (int j = vectorEnd; j < end; ++j) {
+            out[j - begin] = scalarDispatch.calculate(j);
+        }
+    }
+
+    // Runs loop(info, dispatch, timesJ, begin, end) over the events that can contribute to row i,
+    // vectorized with a scalar tail, and records how many pairs were skipped
+    template <typename SimdType, int SimdSize, typename Algorithm, typename PackType, typename LoopType>
+    PackType reduceRow(const int i, LoopType loop) {
+
+        if (flags & hph::Flags::NEIGHBOUR_LIST) {
+            const auto& list = *neighbourList;
+            const auto offset = list.offsets[i];
+            const int count = static_cast<int>(list.offsets[i + 1] - offset);
+            return streamRow<SimdType, SimdSize, PackType>(i, loop, list.distances.data() + offset,
+                                                           list.times.data() + offset, count);
+        }
+
+        const auto window = getWindow(i);
+        const int begin = window.first;
+        const int end = window.second;
+
+        if (flags & hph::Flags::SPATIAL_INDEX) {
+            static thread_local NeighbourScratch scratch;
+            gatherNeighbours(i, begin, end, scratch);
+
+            const int count = static_cast<int>(scratch.distances.size());
+            return streamRow<SimdType, SimdSize, PackType>(i, loop, scratch.distances.data(),
+                                                           scratch.times.data(), count);
+        }
+
+        if (flags & hph::Flags::DISTANCE_CACHE) {
+            static thread_local mm::MemoryManager<RealType> distances;
+            distances.resize(end - begin);
+            distanceCache->decodeRow(i, begin, end, distances.data());
+
+            return streamRow<SimdType, SimdSize, PackType>(i, loop, distances.data(),
+                                                           &times[begin], end - begin);
+        }
+
+        skippedCounts[i] = locationCount - (end - begin);
+        return reduceRowDirect<SimdType, SimdSize, Algorithm, PackType>(i, begin, end, loop);
+    }
+
+    // Runs loop over columns [begin, end) of row i, computing distances on the fly
+    template <typename SimdType, int SimdSize, typename Algorithm, typename PackType, typename LoopType>
+    PackType reduceRowDirect(const int i, const int begin, const int end, LoopType& loop) {
+
+        const int vectorCount = end - (end - begin) % SimdSize;
+
+        DistanceDispatch<SimdType, RealType, Algorithm> dispatch(locationsPtr->data(), i, embeddingDimension);
+        auto sum = loop(LoopTypeInfo<SimdType, SimdSize>(), dispatch, &times[0], begin, vectorCount);
+
+        if (vectorCount < end) { // Edge-cases
+            DistanceDispatch<RealType, RealType, Algorithm> dispatch(locationsPtr->data(), i, embeddingDimension);
+            sum += loop(LoopTypeInfo<RealType, 1>(), dispatch, &times[0], vectorCount, end);
+        }
+
+        return sum;
+    }
+
+    template <typename SimdType, int SimdSize, typename PackType, typename LoopType>
+    PackType streamRow(const int i, LoopType& loop, const RealType* distances, const RealType* timesJ,
+                       const int count) {
+
+        const int vectorCount = count - count % SimdSize;
+
+        StreamDispatch<SimdType, RealType> dispatch(distances);
+        auto sum = loop(LoopTypeInfo<SimdType, SimdSize>(), dispatch, timesJ, 0, vectorCount);
+
+        if (vectorCount < count) { // Edge-cases
+            StreamDispatch<RealType, RealType> dispatch(distances);
+            sum += loop(LoopTypeInfo<RealType, 1>(), dispatch, timesJ, vectorCount, count);
+        }
+
+        skippedCounts[i] = locationCount - count;
+        return sum;
+    }
+
+    struct NeighbourScratch {
+        mm::MemoryManager<RealType> distances;
+        mm::MemoryManager<RealType> times;
+    };
+
+    void gatherNeighbours(const int i, const int begin, const int end, NeighbourScratch& scratch) {
+
+        scratch.distances.clear();
+        scratch.times.clear();
+
+        spatialIndex->forEachNeighbour(locationsPtr->data(), i, getSpatialCutoff(),
+                                      [this, begin, end, &scratch](const int j, const RealType distance) {
+            if (j >= begin && j < end) {
+                scratch.distances.push_back(distance);
+                scratch.times.push_back(times[j]);
+            }
+        });
+    }
+
+    double getLogCutoffTolerance() const {
+        // Without truncation, only pairs whose kernels underflow are dropped
+        return std::log(truncationTolerance > 0.0 ?
+                        truncationTolerance : std::numeric_limits<RealType>::min());
+    }
+
+    RealType getSpatialCutoff() const {
+        // Both spatial kernels fall below tolerance * (peak value) beyond this distance
+        return static_cast<RealType>(std::sqrt(-2.0 * getLogCutoffTolerance()) / std::min(sigmaXprec, tauXprec));
+    }
+
+    void updatePairStructures() {
+        updateSpatialIndex();
+        updateNeighbourList();
+        updateDistanceCache();
+    }
+
+    CacheStorage getCacheStorage() const {
+        return (flags & hph::Flags::DISTANCE_CACHE_HALF) ? CacheStorage::Half :
+               (flags & hph::Flags::DISTANCE_CACHE_DOUBLE) ? CacheStorage::Double :
+               CacheStorage::Float;
+    }
+
+    void updateDistanceCache() {
+
+        if (!(flags & hph::Flags::DISTANCE_CACHE) || distanceCacheKnown) {
+            return;
         }
 
-        std::fill(std::begin(*probsSelfExcitePtr), std::end(*probsSelfExcitePtr),
-                  static_cast<RealType>(0.0));
+        if (distanceCache.use_count() > 1) { // Shared with clones
+            distanceCache = std::make_shared<DistanceCache<RealType>>();
+        }
+        distanceCache->resize(locationCount, getCacheStorage());
 
         for_each(0, locationCount, [this](const int i) {
+            DistanceDispatch<RealType, RealType, Generic> dispatch(locationsPtr->data(), i, embeddingDimension);
+            for (int j = i + 1; j < locationCount; ++j) {
+                distanceCache->set(i, j, dispatch.calculate(j));
+            }
+        }, ParallelType());
 
-            const int vectorCount = locationCount - locationCount % SimdSize;
+        distanceCacheKnown = true;
+    }
 
-            DistanceDispatch<SimdType, RealType, Algorithm> dispatch(*locationsPtr, i, embeddingDimension);
-            auto sumOfRates = innerProbsSelfExciteLoop<SimdType, SimdSize>(dispatch, i, 0, vectorCount);
+    void updateSpatialIndex() {
+        if (flags & hph::Flags::SPATIAL_INDEX) {
+            buildSpatialIndex(getSpatialCutoff());
+        }
+    }
 
-            if (vectorCount < locationCount) { // Edge-cases
-                DistanceDispatch<RealType, RealType, Algorithm> dispatch(*locationsPtr, i, embeddingDimension);
-                sumOfRates += innerProbsSelfExciteLoop<RealType, 1>(dispatch, i, vectorCount, locationCount);
+    void buildSpatialIndex(const RealType radius) {
+        if (!spatialIndex->isValid(radius)) {
+            if (spatialIndex.use_count() > 1) { // Shared with clones
+                spatialIndex = std::make_shared<SpatialIndex<RealType>>(embeddingDimension);
             }
+            spatialIndex->build(locationsPtr->data(), locationCount, radius);
+        }
+    }
+
+    void invalidateSpatialIndex() {
+        if (spatialIndex.use_count() > 1) { // Shared with clones, which keep using it
+            spatialIndex = std::make_shared<SpatialIndex<RealType>>(embeddingDimension);
+        } else {
+            spatialIndex->invalidate();
+        }
+    }
 
-            (*probsSelfExcitePtr)[i] += sumOfRates[1] / (sumOfRates[0] + sumOfRates[1]);
+    // Borrows events that are already in the engine's precision and converts the others
+    static void share(mm::SharedMemoryManager<double>& target, const double* data, size_t length,
+                      const std::shared_ptr<const void>& owner) {
+        target = mm::SharedMemoryManager<double>(owner, data, length);
+    }
+
+    static void share(mm::SharedMemoryManager<float>& target, const double* data, size_t length,
+                      const std::shared_ptr<const void>&) {
+        std::copy(data, data + length, target.modify().begin());
+    }
+
+    void updateNeighbourList() {
+
+        if (!(flags & hph::Flags::NEIGHBOUR_LIST)) {
+            return;
+        }
+
+        const auto logTolerance = getLogCutoffTolerance();
+        const double spatialCutoff = getSpatialCutoff();
+        const double backgroundLag = std::sqrt(-2.0 * logTolerance) / tauTprec;
+        const double selfExciteLag = -logTolerance / omega;
+
+        if (neighbourListKnown &&
+            spatialCutoff <= builtSpatialCutoff &&
+            backgroundLag <= builtBackgroundLag &&
+            selfExciteLag <= builtSelfExciteLag) {
+            return;
+        }
+
+        // Build for a slightly larger region so that small bandwidth moves reuse the list
+        const double margin = 1.25;
+        builtSpatialCutoff = margin * spatialCutoff;
+        builtBackgroundLag = margin * backgroundLag;
+        builtSelfExciteLag = margin * selfExciteLag;
+
+        const auto radius = static_cast<RealType>(builtSpatialCutoff);
+        buildSpatialIndex(radius);
+
+        if (neighbourList.use_count() > 1) { // Shared with clones
+            neighbourList = std::make_shared<NeighbourList>();
+        }
+        auto& list = *neighbourList;
+        list.offsets.resize(locationCount + 1);
+
+        list.offsets[0] = 0;
+        for_each(0, locationCount, [this, &list, radius](const int i) {
+            const auto window = getWindow(i, builtBackgroundLag, builtSelfExciteLag);
+            std::size_t count = 0;
+            spatialIndex->forEachNeighbour(locationsPtr->data(), i, radius,
+                                           [&window, &count](const int j, const RealType) {
+                if (j >= window.first && j < window.second) {
+                    ++count;
+                }
+            });
+            list.offsets[i + 1] = count;
+        }, ParallelType());
+
+        std::partial_sum(std::begin(list.offsets), std::end(list.offsets), std::begin(list.offsets));
+
+        const auto pairCount = list.offsets[locationCount];
+        list.columns.resize(pairCount);
+        list.distances.resize(pairCount);
+        list.times.resize(pairCount);
+
+        for_each(0, locationCount, [this, &list, radius](const int i) {
+            const auto window = getWindow(i, builtBackgroundLag, builtSelfExciteLag);
+            auto k = list.offsets[i];
+            spatialIndex->forEachNeighbour(locationsPtr->data(), i, radius,
+                                           [this, &list, &window, &k](const int j, const RealType distance) {
+                if (j >= window.first && j < window.second) {
+                    list.columns[k] = j;
+                    list.distances[k] = distance;
+                    list.times[k] = times[j];
+                    ++k;
+                }
+            });
         }, ParallelType());
+
+        neighbourListKnown = true;
+    }
+
+    bool isSymmetric() const {
+        // Per-row gathering paths visit each ordered pair anyway, and the scatter's per-thread partial rows
+        // would make deterministic results depend on the thread count
+        return (flags & hph::Flags::SYMMETRIC) &&
+               !(flags & (hph::Flags::SPATIAL_INDEX | hph::Flags::NEIGHBOUR_LIST | hph::Flags::DETERMINISTIC));
+    }
+
+    std::pair<int, int> getSymmetricWindow(const int i) const {
+
+        if (truncationTolerance <= 0.0) {
+            return std::make_pair(0, locationCount);
+        }
+
+        // Same lag in both directions, so that row i and row j agree on whether pair (i, j) is visited
+        const auto logTolerance = std::log(truncationTolerance);
+        const auto lag = std::max(std::sqrt(-2.0 * logTolerance) / tauTprec, -logTolerance / omega);
+        return getWindow(i, lag, lag);
+    }
+
+    // Splits rows into contiguous blocks of roughly equal numbers of pairs (j > i)
+    mm::MemoryManager<int> partitionTriangle(const mm::MemoryManager<int>& rowEnds, const int blockCount) const {
+
+        mm::MemoryManager<double> cost(locationCount + 1, 0.0);
+        for (int i = 0; i < locationCount; ++i) {
+            cost[i + 1] = cost[i] + (rowEnds[i] - i);
+        }
+
+        mm::MemoryManager<int> boundaries(blockCount + 1, locationCount);
+        boundaries[0] = 0;
+        for (int k = 1; k < blockCount; ++k) {
+            const auto target = cost[locationCount] * k / blockCount;
+            boundaries[k] = static_cast<int>(std::lower_bound(cost.begin(), cost.end(), target) - cost.begin());
+            boundaries[k] = std::max(boundaries[k], boundaries[k - 1]);
+        }
+
+        return boundaries;
     }
 
     template <typename SimdType, int SimdSize, typename DispatchType>
-    RealTypePack<2> innerProbsSelfExciteLoop(const DispatchType& dispatch, const int i, const int begin, const int end) {
+    RealType symmetricRatesLoop(const DispatchType& dispatch, const RealType* timesJ,
+                                RealType* backgroundJ, RealType* selfExciteJ,
+                                const int i, const int begin, const int end) {
 
         const auto zero = SimdType(RealType(0));
-        std::array<SimdType, 2> sum = {zero, zero};
+        SimdType sum = zero;
+
+        const auto timeI = SimdType(RealType(times[i]));
+
+        for (int j = begin; j < end; j += SimdSize) {
+
+            const auto locDist = dispatch.calculate(j);
+            const auto timDiff = SimdHelper<SimdType, RealType>::get(timesJ + j) - timeI;
+
+            const auto background = adhoc::pdf_new(locDist * tauXprec) * adhoc::pdf_new(timDiff * tauTprec);
+            const auto selfexcite = mask(timDiff > zero,
+                                         adhoc::exp(-omega * timDiff) * adhoc::pdf_new(locDist * sigmaXprec));
+
+            sum += background;
+            SimdHelper<SimdType, RealType>::put(
+                    SimdHelper<SimdType, RealType>::get(backgroundJ + j) + background, backgroundJ + j);
+            SimdHelper<SimdType, RealType>::put(
+                    SimdHelper<SimdType, RealType>::get(selfExciteJ + j) + selfexcite, selfExciteJ + j);
+        }
+
+        return reduce(sum);
+    }
+
+    // Each unordered pair i < j adds its background term to rows i and j and, as t_j >= t_i,
+    // its self-excitation term to row j only
+    template <typename SimdType, int SimdSize, typename Algorithm>
+    void computeSymmetricRates(const RealType backgroundScale, const RealType selfExciteScale) {
+
+        mm::MemoryManager<int> rowEnds(locationCount);
+        for_each(0, locationCount, [this, &rowEnds](const int i) {
+            rowEnds[i] = getSymmetricWindow(i).second;
+        }, ParallelType());
+
+        const int blockCount = std::is_same<ParallelType, CpuAccumulate>::value ? 1 : 8 * std::max(nThreads, 1);
+        const auto boundaries = partitionTriangle(rowEnds, blockCount);
+
+        const auto diagonal = adhoc::pdf_new(RealType(0)) * adhoc::pdf_new(RealType(0));
+
+        scatterRows(boundaries, [this, &rowEnds, diagonal](const int first, const int last,
+                                                         RealType* background, RealType* selfExcite) {
+            for (int i = first; i < last; ++i) {
+
+                const int begin = i + 1;
+                const int count = rowEnds[i] - begin;
+                const int vectorCount = count - count % SimdSize;
+
+                RealType sum = diagonal;
+
+                if (flags & hph::Flags::DISTANCE_CACHE) {
+                    static thread_local mm::MemoryManager<RealType> distances;
+                    distances.resize(count);
+                    distanceCache->decodeRow(i, begin, rowEnds[i], distances.data());
+
+                    StreamDispatch<SimdType, RealType> dispatch(distances.data());
+                    sum += symmetricRatesLoop<SimdType, SimdSize>(dispatch, &times[begin],
+                            background + begin, selfExcite + begin, i, 0, vectorCount);
+
+                    if (vectorCount < count) { // Edge-cases
+                        StreamDispatch<RealType, RealType> dispatch(distances.data());
+                        sum += symmetricRatesLoop<RealType, 1>(dispatch, &times[begin],
+                                background + begin, selfExcite + begin, i, vectorCount, count);
+                    }
+                } else {
+                    DistanceDispatch<SimdType, RealType, Algorithm> dispatch(locationsPtr->data(), i, embeddingDimension);
+                    sum += symmetricRatesLoop<SimdType, SimdSize>(dispatch, &times[0],
+                            background, selfExcite, i, begin, begin + vectorCount);
+
+                    if (vectorCount < count) { // Edge-cases
+                        DistanceDispatch<RealType, RealType, Algorithm> dispatch(locationsPtr->data(), i, embeddingDimension);
+                        sum += symmetricRatesLoop<RealType, 1>(dispatch, &times[0],
+                                background, selfExcite, i, begin + vectorCount, rowEnds[i]);
+                    }
+                }
+
+                background[i] += sum;
+            }
+        }, ParallelType());
+
+        for_each(0, locationCount, [this, backgroundScale, selfExciteScale](const int i) {
+            backgroundRates[i] *= backgroundScale;
+            selfExciteRates[i] *= selfExciteScale;
+            const auto window = getSymmetricWindow(i);
+            skippedCounts[i] = locationCount - (window.second - window.first);
+        }, ParallelType());
+    }
+
+    template <typename SimdType, int SimdSize, typename Algorithm>
+    void computeRatesGeneric() {
 
         const auto tauXprecD = pow(tauXprec, embeddingDimension);
         const auto sigmaXprecD = pow(sigmaXprec, embeddingDimension);
-        const auto mu0TauXprecDTauTprec = mu0 * tauXprecD * tauTprec;
-        const auto sigmaXprecDThetaOmega = sigmaXprecD * theta * omega;
+        const auto backgroundScale = tauXprecD * tauTprec;
+        const auto selfExciteScale = sigmaXprecD * omega;
 
-        const auto timeI = SimdType(RealType(times[i]));
+        updatePairStructures();
+
+        const auto kernel = getKernelParameters();
+
+        const bool symmetric = isSymmetric();
+        if (symmetric) {
+            computeSymmetricRates<SimdType, SimdSize, Algorithm>(backgroundScale, selfExciteScale);
+        }
+
+        if (!symmetric) {
+            for_each(0, locationCount, [this, &kernel, backgroundScale, selfExciteScale](const int i) {
+                const auto sumOfRates = reduceRow<SimdType, SimdSize, Algorithm, RealTypePack<2>>(i,
+                            [this, i, &kernel](auto info, const auto& dispatch, const RealType* timesJ,
+                                           const int begin, const int end) {
+                    using Info = decltype(info);
+                    return this->template ratesLoop<typename Info::SimdType, Info::SimdSize>(
+                            dispatch, timesJ, times[i], begin, end, kernel);
+                });
+
+                backgroundRates[i] = sumOfRates[0] * backgroundScale;
+                selfExciteRates[i] = sumOfRates[1] * selfExciteScale;
+            }, ParallelType());
+        }
+
+        computeIntegrals();
+        ratesKnown = true;
+    }
+
+    // Updates the cached rates after events [oldCount, locationCount) were appended: new rows are computed in
+    // full and, as self-excitation only looks back in time, existing rows within reach of the new events just
+    // gain their background terms. Rows use the plain time windows, which agree with the pruned pair structures
+    // up to the truncation tolerance.
+    template <typename SimdType, int SimdSize, typename Algorithm>
+    void appendRates(const int oldCount, const double oldEnd) {
+
+        const auto backgroundScale = pow(tauXprec, embeddingDimension) * tauTprec;
+        const auto selfExciteScale = pow(sigmaXprec, embeddingDimension) * omega;
+        const auto kernel = getKernelParameters();
+
+        auto rowLoop = [this, &kernel](const int i) {
+            return [this, i, &kernel](auto info, const auto& dispatch, const RealType* timesJ,
+                                      const int begin, const int end) {
+                using Info = decltype(info);
+                return this->template ratesLoop<typename Info::SimdType, Info::SimdSize>(
+                        dispatch, timesJ, times[i], begin, end, kernel);
+            };
+        };
+
+        for_each(oldCount, locationCount, [&](const int i) {
+            const auto window = getWindow(i);
+            auto loop = rowLoop(i);
+            const auto sumOfRates = reduceRowDirect<SimdType, SimdSize, Algorithm, RealTypePack<2>>(
+                    i, window.first, window.second, loop);
+            backgroundRates[i] = sumOfRates[0] * backgroundScale;
+            selfExciteRates[i] = sumOfRates[1] * selfExciteScale;
+            skippedCounts[i] = locationCount - (window.second - window.first);
+        }, ParallelType());
+
+        const auto first = std::begin(times);
+        const int reach = truncationTolerance > 0.0 ?
+                static_cast<int>(std::lower_bound(first, first + oldCount, static_cast<RealType>(
+                        times[oldCount] - std::sqrt(-2.0 * std::log(truncationTolerance)) / tauTprec)) - first) :
+                0;
+        const int appended = locationCount - oldCount;
+
+        for_each(0, oldCount, [&](const int i) {
+            if (i < reach) {
+                skippedCounts[i] += appended;
+                return;
+            }
+            const auto window = getWindow(i);
+            if (window.second > oldCount) {
+                auto loop = rowLoop(i);
+                const auto sumOfRates = reduceRowDirect<SimdType, SimdSize, Algorithm, RealTypePack<2>>(
+                        i, oldCount, window.second, loop);
+                backgroundRates[i] += sumOfRates[0] * backgroundScale;
+            }
+            skippedCounts[i] = locationCount - (window.second - window.first);
+        }, ParallelType());
+
+        appendIntegrals(oldCount, oldEnd);
+    }
+
+    // Same sums as ratesLoop() at the rows of the query points, which need not be events; queries are
+    // independent, so they are spread over the threads
+    template <typename SimdType, int SimdSize, typename Algorithm>
+    void evaluateIntensityGeneric(double* queryLocations, double* queryTimes, const size_t count,
+                                  double* intensity, double* background, double* selfExcite) {
+
+        const auto norm = pow(M_1_SQRT_2PI, embeddingDimension - 1);
+        const auto backgroundScale = norm * mu0 * pow(tauXprec, embeddingDimension) * tauTprec;
+        const auto selfExciteScale = norm * theta * pow(sigmaXprec, embeddingDimension) * omega;
+        const auto kernel = getKernelParameters();
+
+        mm::MemoryManager<RealType> queries(count * embeddingDimension);
+        mm::bufferedCopy(queryLocations, queryLocations + count * embeddingDimension, begin(queries), buffer);
+
+        const auto locations = locationsPtr->data();
+
+        for_each(0, static_cast<int>(count), [&](const int q) {
+
+            const auto time = static_cast<RealType>(queryTimes[q]);
+            const auto window = getTimeWindow(time);
+            const int vectorCount = window.second - (window.second - window.first) % SimdSize;
+
+            DistanceDispatch<SimdType, RealType, Algorithm> dispatch(locations, queries.data(), q, embeddingDimension);
+            auto sumOfRates = ratesLoop<SimdType, SimdSize>(dispatch, &times[0], time,
+                                                            window.first, vectorCount, kernel);
+
+            if (vectorCount < window.second) { // Edge-cases
+                DistanceDispatch<RealType, RealType, Algorithm> dispatch(locations, queries.data(), q, embeddingDimension);
+                sumOfRates += ratesLoop<RealType, 1>(dispatch, &times[0], time,
+                                                     vectorCount, window.second, kernel);
+            }
+
+            const double backgroundRate = sumOfRates[0] * backgroundScale;
+            const double selfExciteRate = sumOfRates[1] * selfExciteScale;
+
+            intensity[q] = backgroundRate + selfExciteRate;
+            if (background != nullptr) {
+                background[q] = backgroundRate;
+            }
+            if (selfExcite != nullptr) {
+                selfExcite[q] = selfExciteRate;
+            }
+        }, ParallelType());
+    }
+
+    // Integrals of the background and self-excitation kernels of events [begin, end) over the box
+    // [lower, upper] x [startTime, endTime]; the spatial kernels are Gaussian, so each factorises into products
+    // of normal CDF differences
+    template <typename SimdType, int SimdSize>
+    RealTypePack<2> compensatorLoop(const RealType* columns, const RealType* timesJ,
+                                    const double* lower, const double* upper,
+                                    const double startTime, const double endTime,
+                                    const int begin, const int end, const KernelParameters& p) {
+
+        const auto zero = SimdType(RealType(0));
+        const auto one = SimdType(RealType(1));
+        std::array<SimdType, 2> sum = {zero, zero};
+
+        auto cdf = [](const SimdType x) {
+            return adhoc::exp(math::phi_new(x));
+        };
 
         for (int j = begin; j < end; j += SimdSize) {
 
-            const auto locDist = dispatch.calculate(j); //SimdHelper<SimdType, RealType>::get(&locDists[i * locationCount + j]);
-            const auto timDiff = timeI - SimdHelper<SimdType, RealType>::get(&times[j]);
+            auto backgroundMass = one;
+            auto selfExciteMass = one;
+            for (int d = 0; d < embeddingDimension; ++d) {
+                const auto x = SimdHelper<SimdType, RealType>::get(columns + d * locationCount + j);
+                const auto lowerDiff = SimdType(RealType(lower[d])) - x;
+                const auto upperDiff = SimdType(RealType(upper[d])) - x;
 
-            const auto background =  mu0TauXprecDTauTprec *
-                               adhoc::pdf_new(locDist * tauXprec) * adhoc::pdf_new(timDiff * tauTprec);
+                backgroundMass *= cdf(upperDiff * p.tauXprec) - cdf(lowerDiff * p.tauXprec);
+                selfExciteMass *= cdf(upperDiff * p.sigmaXprec) - cdf(lowerDiff * p.sigmaXprec);
+            }
 
-            const auto selfexcite = sigmaXprecDThetaOmega * mask(timDiff > zero,
-                                                                 adhoc::exp(-omega * timDiff) * adhoc::pdf_new(locDist * sigmaXprec));
+            const auto timeJ = SimdHelper<SimdType, RealType>::get(timesJ + j);
+            const auto startDiff = SimdType(RealType(startTime)) - timeJ;
+            const auto endDiff = SimdType(RealType(endTime)) - timeJ;
 
-            sum[0] += background;
-            sum[1] += selfexcite;
+            const auto backgroundTime = cdf(endDiff * p.tauTprec) - cdf(startDiff * p.tauTprec);
+            const auto selfExciteTime = adhoc::exp(-p.omega * mask(startDiff > zero, startDiff)) -
+                                        adhoc::exp(-p.omega * mask(endDiff > zero, endDiff));
+
+            sum[0] += backgroundMass * backgroundTime;
+            sum[1] += selfExciteMass * selfExciteTime;
         }
 
         return reduce<SimdType,2>(sum);
-        ;
+    }
+
+    // Splits every box's event range into fixed blocks and runs all (box, block) tiles in parallel; the blocks
+    // of a box are then summed in order, so results do not depend on the thread count
+    template <typename SimdType, int SimdSize>
+    void evaluateCompensatorGeneric(double* lower, double* upper, double* startTimes, double* endTimes,
+                                    const size_t count, double* expected, double* background, double* selfExcite) {
+
+        const int blockSize = 1024;
+        const auto kernel = getKernelParameters();
+
+        // Column-major copy of the locations, so that coordinates load as SIMD batches
+        mm::MemoryManager<RealType> columns(embeddingDimension * locationCount);
+        const auto locations = locationsPtr->data();
+        for_each(0, locationCount, [&](const int i) {
+            for (int d = 0; d < embeddingDimension; ++d) {
+                columns[d * locationCount + i] = locations[i * embeddingDimension + d];
+            }
+        }, ParallelType());
+
+        mm::MemoryManager<std::pair<int, int>> windows(count);
+        mm::MemoryManager<int> offsets(count + 1, 0);
+        for (size_t q = 0; q < count; ++q) {
+            assert(startTimes[q] <= endTimes[q]);
+            windows[q] = std::make_pair(getTimeWindow(startTimes[q]).first, getTimeWindow(endTimes[q]).second);
+            const int length = std::max(windows[q].second - windows[q].first, 0);
+            offsets[q + 1] = offsets[q] + (length + blockSize - 1) / blockSize;
+        }
+
+        mm::MemoryManager<RealTypePack<2>> partials(offsets[count], RealTypePack<2>(0.0));
+
+        for_each(0, offsets[count], [&](const int tile) {
+
+            const auto q = std::upper_bound(offsets.begin(), offsets.end(), tile) - offsets.begin() - 1;
+            const int begin = windows[q].first + (tile - offsets[q]) * blockSize;
+            const int end = std::min(begin + blockSize, windows[q].second);
+            const int vectorCount = end - (end - begin) % SimdSize;
+
+            const double* lowerQ = lower + q * embeddingDimension;
+            const double* upperQ = upper + q * embeddingDimension;
+
+            auto sums = compensatorLoop<SimdType, SimdSize>(columns.data(), &times[0], lowerQ, upperQ,
+                    startTimes[q], endTimes[q], begin, vectorCount, kernel);
+            if (vectorCount < end) { // Edge-cases
+                sums += compensatorLoop<RealType, 1>(columns.data(), &times[0], lowerQ, upperQ,
+                        startTimes[q], endTimes[q], vectorCount, end, kernel);
+            }
+
+            partials[tile] = sums;
+        }, ParallelType());
+
+        for (size_t q = 0; q < count; ++q) {
+            RealTypePack<2> sums(0.0);
+            for (int tile = offsets[q]; tile < offsets[q + 1]; ++tile) {
+                sums += partials[tile];
+            }
+
+            const double backgroundCount = mu0 * sums[0];
+            const double selfExciteCount = theta * sums[1];
+
+            expected[q] = backgroundCount + selfExciteCount;
+            if (background != nullptr) {
+                background[q] = backgroundCount;
+            }
+            if (selfExcite != nullptr) {
+                selfExcite[q] = selfExciteCount;
+            }
+        }
+    }
+
+    // Removes the first evicted events from the cached rates and integrals, before storage is compacted; only
+    // rows whose windows reach back to them change
+    template <typename SimdType, int SimdSize, typename Algorithm>
+    void evictRates(const int evicted) {
+
+        const auto backgroundScale = pow(tauXprec, embeddingDimension) * tauTprec;
+        const auto selfExciteScale = pow(sigmaXprec, embeddingDimension) * omega;
+        const auto kernel = getKernelParameters();
+
+        const auto first = std::begin(times);
+        const int reach = truncationTolerance > 0.0 ?
+                static_cast<int>(std::upper_bound(first, first + locationCount, static_cast<RealType>(
+                        times[evicted - 1] + getWindowLag())) - first) :
+                locationCount;
+
+        for_each(evicted, locationCount, [&](const int i) {
+            if (i >= reach) {
+                skippedCounts[i] -= evicted;
+                return;
+            }
+            const auto window = getWindow(i);
+            if (window.first < evicted) {
+                auto loop = [this, i, &kernel](auto info, const auto& dispatch, const RealType* timesJ,
+                                               const int begin, const int end) {
+                    using Info = decltype(info);
+                    return this->template ratesLoop<typename Info::SimdType, Info::SimdSize>(
+                            dispatch, timesJ, times[i], begin, end, kernel);
+                };
+                const auto sumOfRates = reduceRowDirect<SimdType, SimdSize, Algorithm, RealTypePack<2>>(
+                        i, window.first, evicted, loop);
+                // Where the evicted events made up most of a rate the difference can round below zero
+                backgroundRates[i] = std::max(static_cast<SumType>(backgroundRates[i] - sumOfRates[0] * backgroundScale),
+                                              SumType(0));
+                selfExciteRates[i] = std::max(static_cast<SumType>(selfExciteRates[i] - sumOfRates[1] * selfExciteScale),
+                                              SumType(0));
+                // Of the remaining locationCount - evicted columns, the row keeps [evicted, window.second)
+                skippedCounts[i] = locationCount - window.second;
+            } else {
+                skippedCounts[i] -= evicted;
+            }
+        }, ParallelType());
+
+        const double end = times[locationCount - 1];
+        const auto integrals =
+                accumulate(0, evicted, RealTypePack<2>(0.0), [this, end](const int i) {
+
+                    RealTypePack<2> integral(0.0);
+                    integral[0] = adhoc::exp(math::phi_new(tauTprec * (end - times[i]))) -
+                                  adhoc::exp(math::phi_new(tauTprec * (-times[i])));
+                    integral[1] = adhoc::exp(-omega * (end - times[i]));
+
+                    return integral;
+
+                }, ParallelType());
+
+        backgroundIntegral -= integrals[0];
+        selfExciteDecay -= integrals[1];
+    }
+
+    void computeIntegrals() {
+
+        const auto integrals =
+                accumulate(0, locationCount, RealTypePack<2>(0.0), [this](const int i) {
+
+                    const auto timDiff = times[locationCount - 1] - times[i];
+
+                    RealTypePack<2> integral(0.0);
+                    integral[0] = adhoc::exp(math::phi_new(tauTprec * timDiff)) -
+                                  adhoc::exp(math::phi_new(tauTprec * (-times[i])));
+                    integral[1] = adhoc::exp(-omega * timDiff);
+
+                    return integral;
+
+                }, ParallelType());
+
+        backgroundIntegral = integrals[0];
+        selfExciteDecay = integrals[1];
+    }
+
+    // Shifts the integrals from end time oldEnd to the new last event after events [oldCount, locationCount)
+    // were appended. The decay terms of existing events all shrink by one factor; their background terms
+    // Phi(tauTprec * (T - t_i)) only move within about 9 standard deviations of the end, as older ones are 1
+    // to double precision.
+    void appendIntegrals(const int oldCount, const double oldEnd) {
+
+        const double end = times[locationCount - 1];
+        const auto first = std::begin(times);
+        const int recent = static_cast<int>(std::lower_bound(first, first + oldCount,
+                static_cast<RealType>(oldEnd - 9.0 / tauTprec)) - first);
+
+        const auto increments =
+                accumulate(recent, locationCount, RealTypePack<2>(0.0), [this, oldCount, oldEnd, end](const int i) {
+
+                    RealTypePack<2> increment(0.0);
+                    const auto upper = adhoc::exp(math::phi_new(tauTprec * (end - times[i])));
+                    if (i < oldCount) {
+                        increment[0] = upper - adhoc::exp(math::phi_new(tauTprec * (oldEnd - times[i])));
+                    } else {
+                        increment[0] = upper - adhoc::exp(math::phi_new(tauTprec * (-times[i])));
+                        increment[1] = adhoc::exp(-omega * (end - times[i]));
+                    }
+
+                    return increment;
+
+                }, ParallelType());
+
+        backgroundIntegral += increments[0];
+        selfExciteDecay = selfExciteDecay * std::exp(-omega * (end - oldEnd)) + increments[1];
+    }
+
+    SumType computeSumOfLikContribsGeneric() {
+
+        // O(N) given the cached per-event rates: lambda_i = mu0 * A_i + theta * B_i
+        SumType delta =
+                accumulate(0, locationCount, SumType(0), [this](const int i) {
+                    return xsimd::log(static_cast<SumType>(mu0 * backgroundRates[i] + theta * selfExciteRates[i]));
+                }, ParallelType());
+
+        if (truncationTolerance > 0.0) {
+            computeTruncationErrorBound();
+        }
+
+        return delta + theta * (selfExciteDecay - locationCount) - mu0 * backgroundIntegral +
+               locationCount * (embeddingDimension - 1) * log(M_1_SQRT_2PI);
+    }
+
+    std::pair<int, int> getWindow(const int i) const {
+        return getTimeWindow(times[i]);
+    }
+
+    // Longest look-back of getWindow(i)
+    double getWindowLag() const {
+        const auto logTolerance = std::log(truncationTolerance);
+        return std::max(std::sqrt(-2.0 * logTolerance) / tauTprec, -logTolerance / omega);
+    }
+
+    std::pair<int, int> getWindow(const int i, const double backgroundLag, const double selfExciteLag) const {
+        return getTimeWindow(times[i], backgroundLag, selfExciteLag);
+    }
+
+    std::pair<int, int> getTimeWindow(const double time) const {
+
+        if (truncationTolerance <= 0.0) {
+            return std::make_pair(0, locationCount);
+        }
+
+        // Kernels fall below tolerance * (peak value) outside these lags
+        const auto logTolerance = std::log(truncationTolerance);
+        return getTimeWindow(time, std::sqrt(-2.0 * logTolerance) / tauTprec, -logTolerance / omega);
+    }
+
+    std::pair<int, int> getTimeWindow(const double time, const double backgroundLag, const double selfExciteLag) const {
+
+        const auto first = std::begin(times);
+        const auto last = first + locationCount;
+
+        const auto lower = std::lower_bound(first, last,
+                static_cast<RealType>(time - std::max(backgroundLag, selfExciteLag)));
+        const auto upper = std::upper_bound(lower, last,
+                static_cast<RealType>(time + backgroundLag));
+
+        return std::make_pair(static_cast<int>(lower - first), static_cast<int>(upper - first));
+    }
+
+    void computeTruncationErrorBound() {
+
+        // Each skipped pair adds at most tolerance * peak kernel value to lambda_i, and
+        // |log(lambda_i + delta_i) - log(lambda_i)| <= delta_i / lambda_i
+        const auto peak = M_1_SQRT_2PI;
+        const auto maxPairRate = truncationTolerance * peak *
+                (mu0 * pow(tauXprec, embeddingDimension) * tauTprec * peak +
+                 theta * pow(sigmaXprec, embeddingDimension) * omega);
+
+        truncationErrorBound =
+                accumulate(0, locationCount, SumType(0), [this, maxPairRate](const int i) {
+                    return skippedCounts[i] * maxPairRate / (mu0 * backgroundRates[i] + theta * selfExciteRates[i]);
+                }, ParallelType());
+    }
+
+    void computeProbsSelfExcite() {
+
+        const auto length = locationCount;
+        if (length != probsSelfExcitePtr->size()) {
+            probsSelfExcitePtr->resize(length);
+        }
+
+        for_each(0, locationCount, [this](const int i) {
+            const auto background = mu0 * backgroundRates[i];
+            const auto selfexcite = theta * selfExciteRates[i];
+            (*probsSelfExcitePtr)[i] = selfexcite / (background + selfexcite);
+        }, ParallelType());
     }
 
 
 // Parallelization helper functions
 
+    // Runs function(first, last, background, selfExcite) over row blocks, which scatters into RealType
+    // buffers for the SIMD loops; the totals are widened into backgroundRates and selfExciteRates
+    template <typename Function>
+    inline void scatterRows(const mm::MemoryManager<int>& boundaries, Function function, CpuAccumulate) {
+        mm::MemoryManager<RealType> background(locationCount, RealType(0));
+        mm::MemoryManager<RealType> selfExcite(locationCount, RealType(0));
+        function(boundaries.front(), boundaries.back(), background.data(), selfExcite.data());
+        std::copy(std::begin(background), std::end(background), std::begin(backgroundRates));
+        std::copy(std::begin(selfExcite), std::end(selfExcite), std::begin(selfExciteRates));
+    }
+
 	template <typename Integer, typename Function>
 	inline void for_each(Integer begin, Integer end, Function function, CpuAccumulate) {
 	    for (; begin != end; ++begin) {
@@ -730,16 +2321,52 @@ public:
 
 	template <typename Integer, typename Function, typename Real>
 	inline Real accumulate(Integer begin, Integer end, Real sum, Function function, CpuAccumulate) {
+	    if (flags & hph::Flags::DETERMINISTIC) {
+	        return accumulateBlocks(begin, end, sum, function, CpuAccumulate());
+	    }
 		for (; begin != end; ++begin) {
 			sum += function(begin);
 		}
 		return sum;
 	}
 
+	static const int deterministicBlockSize = 256;
+
+	// Sums function over fixed blocks of deterministicBlockSize terms, in parallel, and then combines the block
+	// sums in a fixed pairwise tree, so that the result is bitwise identical for any thread count and schedule
+	template <typename Integer, typename Function, typename Real, typename Parallel>
+	inline Real accumulateBlocks(const Integer begin, const Integer end, const Real sum, Function function,
+	                             Parallel parallel) {
+
+	    const int blockCount = static_cast<int>((end - begin + deterministicBlockSize - 1) / deterministicBlockSize);
+	    if (blockCount == 0) {
+	        return sum;
+	    }
+
+	    mm::MemoryManager<Real> partials(blockCount, sum);
+	    for_each(0, blockCount, [begin, end, &function, &partials](const int block) {
+	        const Integer first = begin + static_cast<Integer>(block) * deterministicBlockSize;
+	        const Integer last = std::min(end, static_cast<Integer>(first + deterministicBlockSize));
+	        auto partial = function(first);
+	        for (Integer i = first + 1; i < last; ++i) {
+	            partial += function(i);
+	        }
+	        partials[block] = partial;
+	    }, parallel);
+
+	    for (int width = 1; width < blockCount; width *= 2) {
+	        for (int block = 0; block + width < blockCount; block += 2 * width) {
+	            partials[block] += partials[block + width];
+	        }
+	    }
+
+	    return sum + partials[0];
+	}
+
 #ifdef USE_C_ASYNC
 	template <typename Integer, typename Function, typename Real>
 	inline Real accumulate_thread(Integer begin, Integer end, Real sum, Function function) {
-		std::vector<std::future<Real>> results;
+		mm::MemoryManager<std::future<Real>> results;
 
 		int chunkSize = (end - begin) / nThreads;
 		int start = 0;
@@ -774,7 +2401,7 @@ public:
 #ifdef USE_THREAD_POOL
 	template <typename Integer, typename Function, typename Real>
 	inline Real accumulate_thread_pool(Integer begin, Integer end, Real sum, Function function) {
-		std::vector<std::future<Real>> results;
+		mm::MemoryManager<std::future<Real>> results;
 
 		int chunkSize = (end - begin) / nThreads;
 		int start = 0;
@@ -813,6 +2440,10 @@ public:
 	template <typename Integer, typename Function, typename Real>
 	inline Real accumulate(Integer begin, Integer end, Real sum, Function function, TbbAccumulate) {
 
+	    if (flags & hph::Flags::DETERMINISTIC) {
+	        return accumulateBlocks(begin, end, sum, function, TbbAccumulate());
+	    }
+
 		return tbb::parallel_reduce(
  			tbb::blocked_range<size_t>(begin, end
  			//, 200
@@ -845,6 +2476,37 @@ public:
 				}
 		);
 	}
+
+    template <typename Function>
+    inline void scatterRows(const mm::MemoryManager<int>& boundaries, Function function, TbbAccumulate) {
+
+        using Accumulator = std::pair<mm::MemoryManager<RealType>, mm::MemoryManager<RealType>>;
+        tbb::enumerable_thread_specific<Accumulator> accumulators([this]() {
+            return Accumulator(mm::MemoryManager<RealType>(locationCount, RealType(0)),
+                               mm::MemoryManager<RealType>(locationCount, RealType(0)));
+        });
+
+        tbb::parallel_for(
+                tbb::blocked_range<size_t>(0, boundaries.size() - 1, 1),
+                [&boundaries, &accumulators, &function](const tbb::blocked_range<size_t>& r) -> void {
+                    auto& local = accumulators.local();
+                    for (auto k = r.begin(); k != r.end(); ++k) {
+                        function(boundaries[k], boundaries[k + 1], local.first.data(), local.second.data());
+                    }
+                }
+        );
+
+        for_each(0, locationCount, [this, &accumulators](const int i) {
+            SumType background = 0;
+            SumType selfExcite = 0;
+            for (const auto& local : accumulators) {
+                background += local.first[i];
+                selfExcite += local.second[i];
+            }
+            backgroundRates[i] = background;
+            selfExciteRates[i] = selfExcite;
+        }, TbbAccumulate());
+    }
 #endif
 
 private:
@@ -864,13 +2526,13 @@ private:
     double sumOfLikContribs;
     double storedSumOfLikContribs;
 
-    mm::MemoryManager<RealType> times;
+    mm::SharedMemoryManager<RealType> times;
 
-    mm::MemoryManager<RealType> locations0;
-    mm::MemoryManager<RealType> locations1;
+    mm::SharedMemoryManager<RealType> locations0;
+    mm::SharedMemoryManager<RealType> locations1;
 
-    mm::MemoryManager<RealType>* locationsPtr;
-    mm::MemoryManager<RealType>* storedLocationsPtr;
+    mm::SharedMemoryManager<RealType>* locationsPtr;
+    mm::SharedMemoryManager<RealType>* storedLocationsPtr;
 
     mm::MemoryManager<RealType> probsSelfExcite;
     mm::MemoryManager<RealType>* probsSelfExcitePtr;
@@ -884,9 +2546,51 @@ private:
     mm::MemoryManager<RealType> gradient;
     mm::MemoryManager<RealType>* gradientPtr;
 
+    mm::MemoryManager<SumType> backgroundRates; // A_i, excludes mu0
+    mm::MemoryManager<SumType> selfExciteRates; // B_i, excludes theta
+    double backgroundIntegral;
+    double selfExciteDecay; // Sum of exp(-omega * (T - t_i)), kept apart from -N so appends can rescale it
+
+    mm::MemoryManager<SumType> storedBackgroundRates;
+    mm::MemoryManager<SumType> storedSelfExciteRates;
+    mm::MemoryManager<int> storedSkippedCounts;
+    double storedBackgroundIntegral;
+    double storedSelfExciteDecay;
+
+    mm::MemoryManager<int> skippedCounts;
+    double truncationTolerance;
+    double truncationErrorBound;
+    double windowLength;
+
+    // Pair structures are shared with clones until either side rebuilds them
+    std::shared_ptr<SpatialIndex<RealType>> spatialIndex;
+
+    // Compressed sparse row list of (j, distance, t_j) within the cut-off region
+    struct NeighbourList {
+        mm::MemoryManager<std::size_t> offsets;
+        mm::MemoryManager<int> columns;
+        mm::MemoryManager<RealType> distances;
+        mm::MemoryManager<RealType> times;
+    };
+    std::shared_ptr<NeighbourList> neighbourList;
+    double builtSpatialCutoff;
+    double builtBackgroundLag;
+    double builtSelfExciteLag;
+    bool neighbourListKnown;
+
+    std::shared_ptr<DistanceCache<RealType>> distanceCache;
+    bool distanceCacheKnown;
+
     mm::MemoryManager<double> buffer;
 
     bool isStoredLikContribsEmpty;
+    bool ratesKnown;
+    bool storedRatesKnown;
+
+    StateVersion likelihoodVersion;
+    StateVersion gradientVersion;
+    StateVersion probsVersion;
+    bool storedLikelihoodKnown;
 
     int nThreads;
 
@@ -896,89 +2600,7 @@ private:
 
 };
 
-// factory
-std::shared_ptr<AbstractHawkes>
-constructNewHawkesDoubleNoParallelNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
-	defaultOut << "DOUBLE, NO PARALLEL, NO SIMD" << std::endl;
-	return std::make_shared<NewHawkes<DoubleNoSimdTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
-}
-
-std::shared_ptr<AbstractHawkes>
-constructNewHawkesDoubleTbbNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
-    defaultOut << "DOUBLE, TBB PARALLEL, NO SIMD" << std::endl;
-    return std::make_shared<NewHawkes<DoubleNoSimdTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
-}
-
-std::shared_ptr<AbstractHawkes>
-constructNewHawkesFloatNoParallelNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
-    defaultOut << "SINGLE, NO PARALLEL, NO SIMD" << std::endl;
-    return std::make_shared<NewHawkes<FloatNoSimdTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
-}
-
-std::shared_ptr<AbstractHawkes>
-constructNewHawkesFloatTbbNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
-    defaultOut << "SINGLE, TBB PARALLEL, NO SIMD" << std::endl;
-    return std::make_shared<NewHawkes<FloatNoSimdTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
-}
-
-#ifdef USE_SIMD
-
-#ifdef USE_AVX
-    std::shared_ptr<AbstractHawkes>
-    constructNewHawkesDoubleNoParallelAvx(int embeddingDimension, int locationCount, long flags, int threads) {
-        defaultOut << "DOUBLE, NO PARALLEL, AVX" << std::endl;
-        return std::make_shared<NewHawkes<DoubleAvxTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
-    }
-
-    std::shared_ptr<AbstractHawkes>
-    constructNewHawkesDoubleTbbAvx(int embeddingDimension, int locationCount, long flags, int threads) {
-        defaultOut << "DOUBLE, TBB PARALLEL, AVX" << std::endl;
-        return std::make_shared<NewHawkes<DoubleAvxTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
-    }
-#endif
-
-#ifdef USE_AVX512
-    std::shared_ptr<AbstractHawkes>
-    constructNewHawkesDoubleNoParallelAvx512(int embeddingDimension, int locationCount, long flags, int threads) {
-        defaultOut << "DOUBLE, NO PARALLEL, AVX512" << std::endl;
-        return std::make_shared<NewHawkes<DoubleAvx512TypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
-    }
-
-    std::shared_ptr<AbstractHawkes>
-    constructNewHawkesDoubleTbbAvx512(int embeddingDimension, int locationCount, long flags, int threads) {
-        defaultOut << "DOUBLE, TBB PARALLEL, AVX512" << std::endl;
-        return std::make_shared<NewHawkes<DoubleAvx512TypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
-    }
-#endif
-
-#ifdef USE_SSE
-    std::shared_ptr<AbstractHawkes>
-    constructNewHawkesDoubleNoParallelSse(int embeddingDimension, int locationCount, long flags, int threads) {
-        defaultOut << "DOUBLE, NO PARALLEL, SSE" << std::endl;
-        return std::make_shared<NewHawkes<DoubleSseTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
-    }
-
-    std::shared_ptr<AbstractHawkes>
-    constructNewHawkesDoubleTbbSse(int embeddingDimension, int locationCount, long flags, int threads) {
-        defaultOut << "DOUBLE, TBB PARALLEL, SSE" << std::endl;
-        return std::make_shared<NewHawkes<DoubleSseTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
-    }
-
-	std::shared_ptr<AbstractHawkes>
-	constructNewHawkesFloatNoParallelSse(int embeddingDimension, int locationCount, long flags, int threads) {
-        defaultOut << "SINGLE, NO PARALLEL, SSE" << std::endl;
-        return std::make_shared<NewHawkes<FloatSseTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
-	}
-
-	std::shared_ptr<AbstractHawkes>
-	constructNewHawkesFloatTbbSse(int embeddingDimension, int locationCount, long flags, int threads) {
-        defaultOut << "SINGLE, TBB PARALLEL, SSE" << std::endl;
-        return std::make_shared<NewHawkes<FloatSseTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
-	}
-#endif
-
-#endif
-
+HPH_ISA_NAMESPACE_END
 } // namespace hph
 
 #endif // _NEWHAWKES_HPP
@@ -0,0 +1,290 @@
+#ifndef _OPTIMIZER_HPP
+#define _OPTIMIZER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <deque>
+#include <vector>
+
+#include "AbstractHawkes.hpp"
+#include "Sampler.hpp"
+
+namespace hph {
+
+    // Bound-constrained limited-memory BFGS for the maximum a posteriori Hawkes parameters under the priors of
+    // the samplers. Variables held at an active bound are dropped from the two-loop recursion and trial points
+    // are projected back into the box. Each backtracking round of the Armijo line search evaluates several
+    // step lengths with one getSumOfLikContribsBatch() sweep; the gradient is only computed at accepted points.
+    class LbfgsOptimizer {
+    public:
+
+        static const int parameterCount = 6;
+
+        LbfgsOptimizer(AbstractHawkes& engine, const std::vector<int>& indices,
+                       const std::vector<double>& lower, const std::vector<double>& upper,
+                       const int memory = 6, const int stepsPerSweep = 4)
+            : engine(engine), indices(indices), dimension(static_cast<int>(indices.size())),
+              lower(lower), upper(upper), memory(memory), stepsPerSweep(stepsPerSweep),
+              iterations(0), evaluations(0), sweeps(0), converged(false) { }
+
+        // Writes the optimum into result and leaves the engine's parameters there; returns the log-posterior
+        double run(const double* initial, double* result,
+                   const int maxIterations = 100, const double tolerance = 1e-6) {
+
+            std::copy(initial, initial + parameterCount, parameters.begin());
+            std::vector<double> x(dimension);
+            for (int k = 0; k < dimension; ++k) {
+                x[k] = clamp(k, parameters[indices[k]]);
+            }
+
+            std::vector<double> gradient(dimension);
+            double value = evaluate(x, gradient);
+
+            std::deque<std::vector<double>> sHistory;
+            std::deque<std::vector<double>> yHistory;
+
+            std::vector<double> direction(dimension);
+            std::vector<double> trials(stepsPerSweep * parameterCount);
+            std::vector<double> trialValues(stepsPerSweep);
+            std::vector<double> next(dimension);
+            std::vector<double> nextGradient(dimension);
+
+            converged = projectedGradientNorm(x, gradient) < tolerance;
+
+            for (iterations = 0; iterations < maxIterations && !converged; ++iterations) {
+
+                computeDirection(x, gradient, sHistory, yHistory, direction);
+
+                double step = 1.0;
+                if (sHistory.empty()) { // Unscaled steepest descent; keep the first trial step modest
+                    double norm = 0.0;
+                    for (double d : direction) {
+                        norm = std::max(norm, std::abs(d));
+                    }
+                    step = norm > 1.0 ? 1.0 / norm : 1.0;
+                }
+
+                double nextValue = INFINITY;
+                for (int sweep = 0; sweep < maxSweeps && nextValue == INFINITY; ++sweep) {
+
+                    for (int m = 0; m < stepsPerSweep; ++m) {
+                        std::copy(parameters.begin(), parameters.end(), trials.begin() + m * parameterCount);
+                        for (int k = 0; k < dimension; ++k) {
+                            trials[m * parameterCount + indices[k]] = clamp(k, x[k] + step * direction[k]);
+                        }
+                        step *= 0.5;
+                    }
+
+                    engine.getSumOfLikContribsBatch(trials.data(), stepsPerSweep, trialValues.data(), nullptr);
+                    evaluations += stepsPerSweep;
+                    ++sweeps;
+
+                    for (int m = 0; m < stepsPerSweep; ++m) { // Largest step with sufficient decrease
+                        const double* trial = trials.data() + m * parameterCount;
+                        const double trialValue = -trialValues[m] - logPrior(trial);
+
+                        double decrease = 0.0;
+                        for (int k = 0; k < dimension; ++k) {
+                            decrease += gradient[k] * (trial[indices[k]] - x[k]);
+                        }
+
+                        if (trialValue <= value + armijo * decrease) {
+                            for (int k = 0; k < dimension; ++k) {
+                                next[k] = trial[indices[k]];
+                            }
+                            nextValue = trialValue;
+                            break;
+                        }
+                    }
+                }
+
+                if (nextValue == INFINITY) {
+                    if (sHistory.empty()) {
+                        break; // No descent even along the projected gradient
+                    }
+                    sHistory.clear();
+                    yHistory.clear();
+                    continue;
+                }
+
+                evaluate(next, nextGradient);
+
+                std::vector<double> s(dimension);
+                std::vector<double> y(dimension);
+                double sy = 0.0;
+                double yy = 0.0;
+                for (int k = 0; k < dimension; ++k) {
+                    s[k] = next[k] - x[k];
+                    y[k] = nextGradient[k] - gradient[k];
+                    sy += s[k] * y[k];
+                    yy += y[k] * y[k];
+                }
+                if (sy > 1e-10 * yy) { // Skip updates that would lose positive definiteness
+                    sHistory.push_back(s);
+                    yHistory.push_back(y);
+                    if (static_cast<int>(sHistory.size()) > memory) {
+                        sHistory.pop_front();
+                        yHistory.pop_front();
+                    }
+                }
+
+                const double change = value - nextValue;
+                x.swap(next);
+                gradient.swap(nextGradient);
+                value = nextValue;
+
+                converged = projectedGradientNorm(x, gradient) < tolerance ||
+                            change <= functionTolerance * std::max(std::abs(value), 1.0);
+            }
+
+            setParameters(x);
+            engine.setParameters(parameters.data(), parameterCount);
+            std::copy(parameters.begin(), parameters.end(), result);
+
+            return -value;
+        }
+
+        int getIterationCount() const {
+            return iterations;
+        }
+
+        long getEvaluationCount() const {
+            return evaluations;
+        }
+
+        long getSweepCount() const {
+            return sweeps;
+        }
+
+        bool hasConverged() const {
+            return converged;
+        }
+
+    private:
+
+        double clamp(const int k, const double x) const {
+            const int i = indices[k];
+            return std::min(std::max(x, lower[i]), upper[i]);
+        }
+
+        void setParameters(const std::vector<double>& x) {
+            for (int k = 0; k < dimension; ++k) {
+                parameters[indices[k]] = x[k];
+            }
+        }
+
+        // Negative log-posterior and its gradient with respect to the selected parameters
+        double evaluate(const std::vector<double>& x, std::vector<double>& gradient) {
+
+            setParameters(x);
+            engine.setParameters(parameters.data(), parameterCount);
+
+            double logLikelihood;
+            std::array<double, parameterCount> engineGradient;
+            engine.evaluateAll(&logLikelihood, engineGradient.data(), nullptr);
+            ++evaluations;
+
+            for (int k = 0; k < dimension; ++k) {
+                gradient[k] = -logPosteriorDerivative(indices[k], parameters.data(), engineGradient.data());
+            }
+
+            return -logLikelihood - logPrior(parameters.data());
+        }
+
+        bool isHeld(const int k, const std::vector<double>& x, const std::vector<double>& gradient) const {
+            const int i = indices[k];
+            return (x[k] <= lower[i] && gradient[k] > 0.0) || (x[k] >= upper[i] && gradient[k] < 0.0);
+        }
+
+        double projectedGradientNorm(const std::vector<double>& x, const std::vector<double>& gradient) const {
+            double norm = 0.0;
+            for (int k = 0; k < dimension; ++k) {
+                norm = std::max(norm, std::abs(clamp(k, x[k] - gradient[k]) - x[k]));
+            }
+            return norm;
+        }
+
+        // Two-loop recursion over the free variables
+        void computeDirection(const std::vector<double>& x, const std::vector<double>& gradient,
+                              const std::deque<std::vector<double>>& sHistory,
+                              const std::deque<std::vector<double>>& yHistory,
+                              std::vector<double>& direction) const {
+
+            std::vector<bool> free(dimension);
+            for (int k = 0; k < dimension; ++k) {
+                free[k] = !isHeld(k, x, gradient);
+                direction[k] = free[k] ? -gradient[k] : 0.0;
+            }
+
+            const int count = static_cast<int>(sHistory.size());
+            if (count == 0) {
+                return;
+            }
+
+            auto dot = [&](const std::vector<double>& a, const std::vector<double>& b) {
+                double sum = 0.0;
+                for (int k = 0; k < dimension; ++k) {
+                    if (free[k]) {
+                        sum += a[k] * b[k];
+                    }
+                }
+                return sum;
+            };
+
+            std::vector<double> alpha(count);
+            std::vector<double> rho(count);
+            for (int j = count - 1; j >= 0; --j) {
+                rho[j] = 1.0 / dot(yHistory[j], sHistory[j]);
+                alpha[j] = rho[j] * dot(sHistory[j], direction);
+                for (int k = 0; k < dimension; ++k) {
+                    direction[k] -= free[k] ? alpha[j] * yHistory[j][k] : 0.0;
+                }
+            }
+
+            const double gamma = dot(sHistory.back(), yHistory.back()) / dot(yHistory.back(), yHistory.back());
+            for (double& d : direction) {
+                d *= gamma;
+            }
+
+            for (int j = 0; j < count; ++j) {
+                const double beta = rho[j] * dot(yHistory[j], direction);
+                for (int k = 0; k < dimension; ++k) {
+                    direction[k] += free[k] ? (alpha[j] - beta) * sHistory[j][k] : 0.0;
+                }
+            }
+
+            double slope = 0.0;
+            for (int k = 0; k < dimension; ++k) {
+                slope += gradient[k] * direction[k];
+            }
+            if (!(slope < 0.0)) { // Curvature pairs restricted to the free set need not give descent
+                for (int k = 0; k < dimension; ++k) {
+                    direction[k] = free[k] ? -gradient[k] : 0.0;
+                }
+            }
+        }
+
+        static constexpr double armijo = 1e-4;
+        static constexpr double functionTolerance = 1e-12;
+        static const int maxSweeps = 5;
+
+        AbstractHawkes& engine;
+        const std::vector<int> indices;
+        const int dimension;
+        const std::vector<double> lower;
+        const std::vector<double> upper;
+        std::array<double, parameterCount> parameters;
+
+        const int memory;
+        const int stepsPerSweep;
+
+        int iterations;
+        long evaluations;
+        long sweeps;
+        bool converged;
+    };
+
+} // namespace hph
+
+#endif // _OPTIMIZER_HPP
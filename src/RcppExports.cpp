@@ -16,8 +16,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // createEngine
-Rcpp::List createEngine(int embeddingDimension, int locationCount, int tbb, int simd, int gpu, bool single);
-RcppExport SEXP _hpHawkes_createEngine(SEXP embeddingDimensionSEXP, SEXP locationCountSEXP, SEXP tbbSEXP, SEXP simdSEXP, SEXP gpuSEXP, SEXP singleSEXP) {
+Rcpp::List createEngine(int embeddingDimension, int locationCount, int tbb, int simd, int gpu, bool single, int pruning, int distanceCache, int mixed, int deterministic, int symmetric);
+RcppExport SEXP _hpHawkes_createEngine(SEXP embeddingDimensionSEXP, SEXP locationCountSEXP, SEXP tbbSEXP, SEXP simdSEXP, SEXP gpuSEXP, SEXP singleSEXP, SEXP pruningSEXP, SEXP distanceCacheSEXP, SEXP mixedSEXP, SEXP deterministicSEXP, SEXP symmetricSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -27,7 +27,12 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< int >::type simd(simdSEXP);
     Rcpp::traits::input_parameter< int >::type gpu(gpuSEXP);
     Rcpp::traits::input_parameter< bool >::type single(singleSEXP);
-    rcpp_result_gen = Rcpp::wrap(createEngine(embeddingDimension, locationCount, tbb, simd, gpu, single));
+    Rcpp::traits::input_parameter< int >::type pruning(pruningSEXP);
+    Rcpp::traits::input_parameter< int >::type distanceCache(distanceCacheSEXP);
+    Rcpp::traits::input_parameter< int >::type mixed(mixedSEXP);
+    Rcpp::traits::input_parameter< int >::type deterministic(deterministicSEXP);
+    Rcpp::traits::input_parameter< int >::type symmetric(symmetricSEXP);
+    rcpp_result_gen = Rcpp::wrap(createEngine(embeddingDimension, locationCount, tbb, simd, gpu, single, pruning, distanceCache, mixed, deterministic, symmetric));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -99,16 +104,345 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// setTruncation
+void setTruncation(SEXP sexp, double tolerance);
+RcppExport SEXP _hpHawkes_setTruncation(SEXP sexpSEXP, SEXP toleranceSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    setTruncation(sexp, tolerance);
+    return R_NilValue;
+END_RCPP
+}
+// getTruncationErrorBound
+double getTruncationErrorBound(SEXP sexp);
+RcppExport SEXP _hpHawkes_getTruncationErrorBound(SEXP sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    rcpp_result_gen = Rcpp::wrap(getTruncationErrorBound(sexp));
+    return rcpp_result_gen;
+END_RCPP
+}
+// getDistanceCacheFootprint
+double getDistanceCacheFootprint(SEXP sexp);
+RcppExport SEXP _hpHawkes_getDistanceCacheFootprint(SEXP sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    rcpp_result_gen = Rcpp::wrap(getDistanceCacheFootprint(sexp));
+    return rcpp_result_gen;
+END_RCPP
+}
+// getSumOfLikContribsBatch
+Rcpp::List getSumOfLikContribsBatch(SEXP sexp, std::vector<double>& parameters, int count, bool gradient);
+RcppExport SEXP _hpHawkes_getSumOfLikContribsBatch(SEXP sexpSEXP, SEXP parametersSEXP, SEXP countSEXP, SEXP gradientSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< int >::type count(countSEXP);
+    Rcpp::traits::input_parameter< bool >::type gradient(gradientSEXP);
+    rcpp_result_gen = Rcpp::wrap(getSumOfLikContribsBatch(sexp, parameters, count, gradient));
+    return rcpp_result_gen;
+END_RCPP
+}
+// evaluateAll
+Rcpp::List evaluateAll(SEXP sexp, size_t len);
+RcppExport SEXP _hpHawkes_evaluateAll(SEXP sexpSEXP, SEXP lenSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< size_t >::type len(lenSEXP);
+    rcpp_result_gen = Rcpp::wrap(evaluateAll(sexp, len));
+    return rcpp_result_gen;
+END_RCPP
+}
+// runSampler
+Rcpp::List runSampler(SEXP sexp, std::vector<double>& parameters, int iterations, int burnIn, double radius, double seed);
+RcppExport SEXP _hpHawkes_runSampler(SEXP sexpSEXP, SEXP parametersSEXP, SEXP iterationsSEXP, SEXP burnInSEXP, SEXP radiusSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< int >::type iterations(iterationsSEXP);
+    Rcpp::traits::input_parameter< int >::type burnIn(burnInSEXP);
+    Rcpp::traits::input_parameter< double >::type radius(radiusSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(runSampler(sexp, parameters, iterations, burnIn, radius, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// runNuts
+Rcpp::List runNuts(SEXP sexp, std::vector<double>& parameters, std::vector<int>& indices, int iterations, int burnIn, double seed, double targetAcceptance, int maxDepth);
+RcppExport SEXP _hpHawkes_runNuts(SEXP sexpSEXP, SEXP parametersSEXP, SEXP indicesSEXP, SEXP iterationsSEXP, SEXP burnInSEXP, SEXP seedSEXP, SEXP targetAcceptanceSEXP, SEXP maxDepthSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< std::vector<int>& >::type indices(indicesSEXP);
+    Rcpp::traits::input_parameter< int >::type iterations(iterationsSEXP);
+    Rcpp::traits::input_parameter< int >::type burnIn(burnInSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< double >::type targetAcceptance(targetAcceptanceSEXP);
+    Rcpp::traits::input_parameter< int >::type maxDepth(maxDepthSEXP);
+    rcpp_result_gen = Rcpp::wrap(runNuts(sexp, parameters, indices, iterations, burnIn, seed, targetAcceptance, maxDepth));
+    return rcpp_result_gen;
+END_RCPP
+}
+// runChains
+Rcpp::List runChains(SEXP sexp, std::vector<double>& parameters, int chains, int threadsPerChain, int iterations, int burnIn, std::vector<double>& seeds, bool nuts, double radius, std::vector<int>& indices);
+RcppExport SEXP _hpHawkes_runChains(SEXP sexpSEXP, SEXP parametersSEXP, SEXP chainsSEXP, SEXP threadsPerChainSEXP, SEXP iterationsSEXP, SEXP burnInSEXP, SEXP seedsSEXP, SEXP nutsSEXP, SEXP radiusSEXP, SEXP indicesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< int >::type chains(chainsSEXP);
+    Rcpp::traits::input_parameter< int >::type threadsPerChain(threadsPerChainSEXP);
+    Rcpp::traits::input_parameter< int >::type iterations(iterationsSEXP);
+    Rcpp::traits::input_parameter< int >::type burnIn(burnInSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type seeds(seedsSEXP);
+    Rcpp::traits::input_parameter< bool >::type nuts(nutsSEXP);
+    Rcpp::traits::input_parameter< double >::type radius(radiusSEXP);
+    Rcpp::traits::input_parameter< std::vector<int>& >::type indices(indicesSEXP);
+    rcpp_result_gen = Rcpp::wrap(runChains(sexp, parameters, chains, threadsPerChain, iterations, burnIn, seeds, nuts, radius, indices));
+    return rcpp_result_gen;
+END_RCPP
+}
+// runTempering
+Rcpp::List runTempering(SEXP sexp, std::vector<double>& parameters, std::vector<double>& inverseTemperatures, int iterations, int burnIn, double radius, double seed);
+RcppExport SEXP _hpHawkes_runTempering(SEXP sexpSEXP, SEXP parametersSEXP, SEXP inverseTemperaturesSEXP, SEXP iterationsSEXP, SEXP burnInSEXP, SEXP radiusSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type inverseTemperatures(inverseTemperaturesSEXP);
+    Rcpp::traits::input_parameter< int >::type iterations(iterationsSEXP);
+    Rcpp::traits::input_parameter< int >::type burnIn(burnInSEXP);
+    Rcpp::traits::input_parameter< double >::type radius(radiusSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(runTempering(sexp, parameters, inverseTemperatures, iterations, burnIn, radius, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// optimizeMap
+Rcpp::List optimizeMap(SEXP sexp, std::vector<double>& parameters, std::vector<int>& indices, std::vector<double>& lower, std::vector<double>& upper, int maxIterations, double tolerance);
+RcppExport SEXP _hpHawkes_optimizeMap(SEXP sexpSEXP, SEXP parametersSEXP, SEXP indicesSEXP, SEXP lowerSEXP, SEXP upperSEXP, SEXP maxIterationsSEXP, SEXP toleranceSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< std::vector<int>& >::type indices(indicesSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type lower(lowerSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type upper(upperSEXP);
+    Rcpp::traits::input_parameter< int >::type maxIterations(maxIterationsSEXP);
+    Rcpp::traits::input_parameter< double >::type tolerance(toleranceSEXP);
+    rcpp_result_gen = Rcpp::wrap(optimizeMap(sexp, parameters, indices, lower, upper, maxIterations, tolerance));
+    return rcpp_result_gen;
+END_RCPP
+}
+// simulateEvents
+Rcpp::List simulateEvents(std::vector<double>& parameters, int embeddingDimension, int eventCount, double seed, double spread, int threads, int centreCount);
+RcppExport SEXP _hpHawkes_simulateEvents(SEXP parametersSEXP, SEXP embeddingDimensionSEXP, SEXP eventCountSEXP, SEXP seedSEXP, SEXP spreadSEXP, SEXP threadsSEXP, SEXP centreCountSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::vector<double>& >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< int >::type embeddingDimension(embeddingDimensionSEXP);
+    Rcpp::traits::input_parameter< int >::type eventCount(eventCountSEXP);
+    Rcpp::traits::input_parameter< double >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< double >::type spread(spreadSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type centreCount(centreCountSEXP);
+    rcpp_result_gen = Rcpp::wrap(simulateEvents(parameters, embeddingDimension, eventCount, seed, spread, threads, centreCount));
+    return rcpp_result_gen;
+END_RCPP
+}
+// appendEvents
+void appendEvents(SEXP sexp, std::vector<double>& times, std::vector<double>& locations);
+RcppExport SEXP _hpHawkes_appendEvents(SEXP sexpSEXP, SEXP timesSEXP, SEXP locationsSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type times(timesSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type locations(locationsSEXP);
+    appendEvents(sexp, times, locations);
+    return R_NilValue;
+END_RCPP
+}
+// setWindow
+void setWindow(SEXP sexp, double length);
+RcppExport SEXP _hpHawkes_setWindow(SEXP sexpSEXP, SEXP lengthSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< double >::type length(lengthSEXP);
+    setWindow(sexp, length);
+    return R_NilValue;
+END_RCPP
+}
+// getLocationCount
+int getLocationCount(SEXP sexp);
+RcppExport SEXP _hpHawkes_getLocationCount(SEXP sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    rcpp_result_gen = Rcpp::wrap(getLocationCount(sexp));
+    return rcpp_result_gen;
+END_RCPP
+}
+// evaluateIntensity
+Rcpp::List evaluateIntensity(SEXP sexp, std::vector<double>& locations, std::vector<double>& times);
+RcppExport SEXP _hpHawkes_evaluateIntensity(SEXP sexpSEXP, SEXP locationsSEXP, SEXP timesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type locations(locationsSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type times(timesSEXP);
+    rcpp_result_gen = Rcpp::wrap(evaluateIntensity(sexp, locations, times));
+    return rcpp_result_gen;
+END_RCPP
+}
+// evaluateCompensator
+Rcpp::List evaluateCompensator(SEXP sexp, std::vector<double>& lower, std::vector<double>& upper, std::vector<double>& startTimes, std::vector<double>& endTimes);
+RcppExport SEXP _hpHawkes_evaluateCompensator(SEXP sexpSEXP, SEXP lowerSEXP, SEXP upperSEXP, SEXP startTimesSEXP, SEXP endTimesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type lower(lowerSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type upper(upperSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type startTimes(startTimesSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type endTimes(endTimesSEXP);
+    rcpp_result_gen = Rcpp::wrap(evaluateCompensator(sexp, lower, upper, startTimes, endTimes));
+    return rcpp_result_gen;
+END_RCPP
+}
+// writeEventFile
+void writeEventFile(const std::string& path, std::vector<double>& times, std::vector<double>& locations, int embeddingDimension);
+RcppExport SEXP _hpHawkes_writeEventFile(SEXP pathSEXP, SEXP timesSEXP, SEXP locationsSEXP, SEXP embeddingDimensionSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type times(timesSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type locations(locationsSEXP);
+    Rcpp::traits::input_parameter< int >::type embeddingDimension(embeddingDimensionSEXP);
+    writeEventFile(path, times, locations, embeddingDimension);
+    return R_NilValue;
+END_RCPP
+}
+// readEventFileHeader
+Rcpp::List readEventFileHeader(const std::string& path);
+RcppExport SEXP _hpHawkes_readEventFileHeader(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(readEventFileHeader(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// loadEventFile
+double loadEventFile(SEXP sexp, const std::string& path);
+RcppExport SEXP _hpHawkes_loadEventFile(SEXP sexpSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(loadEventFile(sexp, path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// saveState
+void saveState(SEXP sexp, const std::string& path, std::vector<double>& extra);
+RcppExport SEXP _hpHawkes_saveState(SEXP sexpSEXP, SEXP pathSEXP, SEXP extraSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    Rcpp::traits::input_parameter< std::vector<double>& >::type extra(extraSEXP);
+    saveState(sexp, path, extra);
+    return R_NilValue;
+END_RCPP
+}
+// loadState
+std::vector<double> loadState(SEXP sexp, const std::string& path);
+RcppExport SEXP _hpHawkes_loadState(SEXP sexpSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(loadState(sexp, path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// storeState
+void storeState(SEXP sexp);
+RcppExport SEXP _hpHawkes_storeState(SEXP sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    storeState(sexp);
+    return R_NilValue;
+END_RCPP
+}
+// restoreState
+void restoreState(SEXP sexp);
+RcppExport SEXP _hpHawkes_restoreState(SEXP sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sexp(sexpSEXP);
+    restoreState(sexp);
+    return R_NilValue;
+END_RCPP
+}
 
 static const R_CallMethodDef CallEntries[] = {
     {"_hpHawkes_rcpp_hello", (DL_FUNC) &_hpHawkes_rcpp_hello, 0},
-    {"_hpHawkes_createEngine", (DL_FUNC) &_hpHawkes_createEngine, 6},
+    {"_hpHawkes_createEngine", (DL_FUNC) &_hpHawkes_createEngine, 11},
     {"_hpHawkes_setTimesData", (DL_FUNC) &_hpHawkes_setTimesData, 2},
     {"_hpHawkes_setParameters", (DL_FUNC) &_hpHawkes_setParameters, 2},
     {"_hpHawkes_getLogLikelihoodGradient", (DL_FUNC) &_hpHawkes_getLogLikelihoodGradient, 2},
     {"_hpHawkes_getProbsSelfExcite", (DL_FUNC) &_hpHawkes_getProbsSelfExcite, 2},
     {"_hpHawkes_updateLocations", (DL_FUNC) &_hpHawkes_updateLocations, 2},
     {"_hpHawkes_getSumOfLikContribs", (DL_FUNC) &_hpHawkes_getSumOfLikContribs, 1},
+    {"_hpHawkes_setTruncation", (DL_FUNC) &_hpHawkes_setTruncation, 2},
+    {"_hpHawkes_getTruncationErrorBound", (DL_FUNC) &_hpHawkes_getTruncationErrorBound, 1},
+    {"_hpHawkes_getDistanceCacheFootprint", (DL_FUNC) &_hpHawkes_getDistanceCacheFootprint, 1},
+    {"_hpHawkes_getSumOfLikContribsBatch", (DL_FUNC) &_hpHawkes_getSumOfLikContribsBatch, 4},
+    {"_hpHawkes_evaluateAll", (DL_FUNC) &_hpHawkes_evaluateAll, 2},
+    {"_hpHawkes_runSampler", (DL_FUNC) &_hpHawkes_runSampler, 6},
+    {"_hpHawkes_runNuts", (DL_FUNC) &_hpHawkes_runNuts, 8},
+    {"_hpHawkes_runChains", (DL_FUNC) &_hpHawkes_runChains, 10},
+    {"_hpHawkes_runTempering", (DL_FUNC) &_hpHawkes_runTempering, 7},
+    {"_hpHawkes_optimizeMap", (DL_FUNC) &_hpHawkes_optimizeMap, 7},
+    {"_hpHawkes_simulateEvents", (DL_FUNC) &_hpHawkes_simulateEvents, 7},
+    {"_hpHawkes_appendEvents", (DL_FUNC) &_hpHawkes_appendEvents, 3},
+    {"_hpHawkes_setWindow", (DL_FUNC) &_hpHawkes_setWindow, 2},
+    {"_hpHawkes_getLocationCount", (DL_FUNC) &_hpHawkes_getLocationCount, 1},
+    {"_hpHawkes_evaluateIntensity", (DL_FUNC) &_hpHawkes_evaluateIntensity, 3},
+    {"_hpHawkes_evaluateCompensator", (DL_FUNC) &_hpHawkes_evaluateCompensator, 5},
+    {"_hpHawkes_writeEventFile", (DL_FUNC) &_hpHawkes_writeEventFile, 4},
+    {"_hpHawkes_readEventFileHeader", (DL_FUNC) &_hpHawkes_readEventFileHeader, 1},
+    {"_hpHawkes_loadEventFile", (DL_FUNC) &_hpHawkes_loadEventFile, 2},
+    {"_hpHawkes_saveState", (DL_FUNC) &_hpHawkes_saveState, 3},
+    {"_hpHawkes_loadState", (DL_FUNC) &_hpHawkes_loadState, 2},
+    {"_hpHawkes_storeState", (DL_FUNC) &_hpHawkes_storeState, 1},
+    {"_hpHawkes_restoreState", (DL_FUNC) &_hpHawkes_restoreState, 1},
     {NULL, NULL, 0}
 };
 
@@ -0,0 +1,624 @@
+#ifndef _SAMPLER_HPP
+#define _SAMPLER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "AbstractHawkes.hpp"
+
+namespace hph {
+
+    namespace truncnorm {
+
+        // Normal(mean, sd) truncated to (0, Inf)
+        inline double logDensity(const double x, const double mean, const double sd) {
+            if (x <= 0.0) {
+                return -INFINITY;
+            }
+            const auto z = (x - mean) / sd;
+            const auto mass = 0.5 * std::erfc(-mean / (sd * M_SQRT2));
+            return -0.5 * z * z - std::log(sd * mass) - 0.5 * std::log(2.0 * M_PI);
+        }
+
+        // Rejection from the untruncated normal; at least half the mass is kept while mean >= 0
+        template <typename PRNG>
+        double sample(const double mean, const double sd, PRNG& prng) {
+            std::normal_distribution<double> normal(mean, sd);
+            double x;
+            do {
+                x = normal(prng);
+            } while (x <= 0.0);
+            return x;
+        }
+
+    } // namespace truncnorm
+
+    // Half-normal priors of R's Potential(): sd 10 on the first five parameters and sd 1 on mu0
+    inline double priorSd(const int i) {
+        return i == 5 ? 1.0 : 10.0;
+    }
+
+    inline double logPrior(const double* parameters) {
+        double sum = 0.0;
+        for (int i = 0; i < 6; ++i) {
+            sum += truncnorm::logDensity(parameters[i], 0.0, priorSd(i));
+        }
+        return sum;
+    }
+
+    // Derivative of log-likelihood plus log-prior with respect to parameter i, from the engine's gradient,
+    // which differentiates the first three with respect to 1 / x
+    inline double logPosteriorDerivative(const int i, const double* parameters, const double* gradient) {
+        const double x = parameters[i];
+        const double dLogLikelihood = i < 3 ? -gradient[i] / (x * x) : gradient[i];
+        return dLogLikelihood - x / (priorSd(i) * priorSd(i));
+    }
+
+    // Per-parameter proposal radii, scaled towards 44% acceptance after each (growing) block of proposals
+    class RadiusAdaptation {
+    public:
+
+        RadiusAdaptation(const double radius) {
+            radii.fill(radius);
+            sampleBounds.fill(5);
+            sampleCounts.fill(0);
+            acceptances.fill(0);
+        }
+
+        double operator[](const int index) const {
+            return radii[index];
+        }
+
+        void update(const int index, const bool accepted) {
+            if (accepted) {
+                ++acceptances[index];
+            }
+            ++sampleCounts[index];
+            if (sampleCounts[index] == sampleBounds[index]) {
+                const double ratio = static_cast<double>(acceptances[index]) / sampleBounds[index] / 0.44;
+                radii[index] *= std::min(std::max(ratio, 0.5), 2.0);
+
+                sampleCounts[index] = 0;
+                sampleBounds[index] = static_cast<long>(std::ceil(std::pow(sampleBounds[index], 1.1)));
+                acceptances[index] = 0;
+            }
+        }
+
+        const std::array<double, 6>& getRadii() const {
+            return radii;
+        }
+
+        static const int stateLength = 24;
+
+        // Radii and block counters, e.g. for an engine snapshot's extra block
+        void getState(std::vector<double>& state) const {
+            state.insert(state.end(), radii.begin(), radii.end());
+            state.insert(state.end(), sampleBounds.begin(), sampleBounds.end());
+            state.insert(state.end(), sampleCounts.begin(), sampleCounts.end());
+            state.insert(state.end(), acceptances.begin(), acceptances.end());
+        }
+
+        void setState(const double* state) {
+            std::copy(state, state + 6, radii.begin());
+            std::copy(state + 6, state + 12, sampleBounds.begin());
+            std::copy(state + 12, state + 18, sampleCounts.begin());
+            std::copy(state + 18, state + 24, acceptances.begin());
+        }
+
+    private:
+        std::array<double, 6> radii;
+        std::array<long, 6> sampleBounds;
+        std::array<long, 6> sampleCounts;
+        std::array<long, 6> acceptances;
+    };
+
+    // Random-scan univariate truncated-normal proposal: perturbs one of parameters 1, 4, 5 or 6 and returns the
+    // log proposal ratio q(current | proposal) - q(proposal | current)
+    template <typename PRNG>
+    double proposeUnivariate(double* proposal, const int index, const double radius, PRNG& prng) {
+        const double former = proposal[index];
+        proposal[index] = truncnorm::sample(former, radius, prng);
+        return truncnorm::logDensity(former, proposal[index], radius) -
+               truncnorm::logDensity(proposal[index], former, radius);
+    }
+
+    template <typename PRNG>
+    int chooseScanIndex(PRNG& prng) {
+        static const std::array<int, 4> scan = {0, 3, 4, 5};
+        std::uniform_int_distribution<int> choose(0, static_cast<int>(scan.size()) - 1);
+        return scan[choose(prng)];
+    }
+
+    // Random-scan adaptive Metropolis-Hastings over the Hawkes parameters with truncated-normal proposals
+    // and priors, following sampler() in R/Untitled.R
+    class AdaptiveSampler {
+    public:
+
+        static const int parameterCount = 6;
+
+        AdaptiveSampler(AbstractHawkes& engine, const double radius, const unsigned long seed)
+            : engine(engine), prng(seed), radii(radius), accepted(0), proposed(0) { }
+
+        // Writes (iterations - burnIn) x 6 parameter draws into samples and the potential (negative
+        // log-posterior) of each into potentials, if not null
+        void run(const double* initial, const int iterations, const int burnIn,
+                 double* samples, double* potentials) {
+
+            std::array<double, parameterCount> current;
+            std::copy(initial, initial + parameterCount, current.begin());
+
+            engine.setParameters(current.data(), parameterCount);
+            double currentU = potential(current);
+
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+            for (int iteration = 1; iteration <= iterations; ++iteration) {
+
+                ++proposed;
+
+                const int index = chooseScanIndex(prng);
+                auto proposal = current;
+                const double logProposalRatio = proposeUnivariate(proposal.data(), index, radii[index], prng);
+
+                engine.setParameters(proposal.data(), parameterCount);
+                const double proposedU = potential(proposal);
+
+                const bool accept = currentU - proposedU + logProposalRatio > std::log(uniform(prng));
+                if (accept) {
+                    current = proposal;
+                    currentU = proposedU;
+                    ++accepted;
+                } else {
+                    engine.setParameters(current.data(), parameterCount);
+                }
+
+                radii.update(index, accept);
+
+                if (iteration > burnIn) {
+                    const int sample = iteration - burnIn - 1;
+                    std::copy(current.begin(), current.end(), samples + sample * parameterCount);
+                    if (potentials != nullptr) {
+                        potentials[sample] = currentU;
+                    }
+                }
+            }
+        }
+
+        double getAcceptanceRate() const {
+            return proposed > 0 ? static_cast<double>(accepted) / proposed : 0.0;
+        }
+
+        const std::array<double, parameterCount>& getRadii() const {
+            return radii.getRadii();
+        }
+
+        // Adaptation state to resume from with setState(), e.g. after AbstractHawkes::loadState()
+        std::vector<double> getState() const {
+            std::vector<double> state;
+            radii.getState(state);
+            state.push_back(static_cast<double>(accepted));
+            state.push_back(static_cast<double>(proposed));
+            return state;
+        }
+
+        void setState(const std::vector<double>& state) {
+            assert(state.size() == RadiusAdaptation::stateLength + 2);
+            radii.setState(state.data());
+            accepted = static_cast<long>(state[RadiusAdaptation::stateLength]);
+            proposed = static_cast<long>(state[RadiusAdaptation::stateLength + 1]);
+        }
+
+    private:
+
+        double potential(const std::array<double, parameterCount>& parameters) {
+            return -engine.getSumOfLikContribs() - logPrior(parameters.data());
+        }
+
+        AbstractHawkes& engine;
+        std::mt19937_64 prng;
+        RadiusAdaptation radii;
+
+        long accepted;
+        long proposed;
+    };
+
+    // No-U-Turn sampler (Hoffman & Gelman, 2014, algorithm 6) over the log of the selected Hawkes parameters,
+    // with dual-averaging step-size adaptation during burn-in. Each leapfrog step makes one evaluateAll() call.
+    class NutsSampler {
+    public:
+
+        static const int parameterCount = 6;
+
+        NutsSampler(AbstractHawkes& engine, const std::vector<int>& indices, const unsigned long seed,
+                    const double targetAcceptance = 0.8, const int maxDepth = 10)
+            : engine(engine), indices(indices), dimension(static_cast<int>(indices.size())), prng(seed),
+              targetAcceptance(targetAcceptance), maxDepth(maxDepth), stepSize(0.0), evaluations(0) { }
+
+        // Writes (iterations - burnIn) x 6 parameter draws into samples and the potential (negative
+        // log-posterior in the original scale) of each into potentials, if not null
+        void run(const double* initial, const int iterations, const int burnIn,
+                 double* samples, double* potentials) {
+
+            std::copy(initial, initial + parameterCount, parameters.begin());
+
+            Point current(dimension);
+            for (int k = 0; k < dimension; ++k) {
+                current.position[k] = std::log(parameters[indices[k]]);
+            }
+            evaluate(current);
+
+            stepSize = findReasonableStepSize(current);
+
+            // Dual averaging
+            const double mu = std::log(10.0 * stepSize);
+            const double gamma = 0.05;
+            const double t0 = 10.0;
+            const double kappa = 0.75;
+            double logStepSizeBar = 0.0;
+            double statistic = 0.0;
+
+            for (int iteration = 1; iteration <= iterations; ++iteration) {
+
+                for (auto& r : current.momentum) {
+                    r = normal(prng);
+                }
+                const double joint0 = joint(current);
+                const double logU = joint0 + std::log(uniform(prng));
+
+                Point minus = current;
+                Point plus = current;
+                Point proposal = current;
+                double count = 1.0;
+                bool keepGoing = true;
+
+                double alpha = 0.0;
+                double alphaCount = 0.0;
+
+                for (int depth = 0; keepGoing && depth < maxDepth; ++depth) {
+
+                    const int direction = uniform(prng) < 0.5 ? -1 : 1;
+                    Tree tree = direction == -1 ?
+                                buildTree(minus, logU, direction, depth, joint0) :
+                                buildTree(plus, logU, direction, depth, joint0);
+
+                    if (direction == -1) {
+                        minus = tree.minus;
+                    } else {
+                        plus = tree.plus;
+                    }
+
+                    if (tree.keepGoing && uniform(prng) < tree.count / count) {
+                        proposal = tree.proposal;
+                    }
+
+                    count += tree.count;
+                    alpha = tree.alpha;
+                    alphaCount = tree.alphaCount;
+                    keepGoing = tree.keepGoing && noUTurn(minus, plus);
+                }
+
+                current = proposal;
+
+                if (iteration <= burnIn) {
+                    const double eta = 1.0 / (iteration + t0);
+                    statistic = (1.0 - eta) * statistic + eta * (targetAcceptance - alpha / alphaCount);
+                    const double logStepSize = mu - std::sqrt(static_cast<double>(iteration)) / gamma * statistic;
+                    const double weight = std::pow(static_cast<double>(iteration), -kappa);
+                    logStepSizeBar = weight * logStepSize + (1.0 - weight) * logStepSizeBar;
+                    stepSize = iteration == burnIn ? std::exp(logStepSizeBar) : std::exp(logStepSize);
+                } else {
+                    const int sample = iteration - burnIn - 1;
+                    setParameters(current.position);
+                    std::copy(parameters.begin(), parameters.end(), samples + sample * parameterCount);
+                    if (potentials != nullptr) {
+                        potentials[sample] = current.potential;
+                    }
+                }
+            }
+        }
+
+        double getStepSize() const {
+            return stepSize;
+        }
+
+        long getEvaluationCount() const {
+            return evaluations;
+        }
+
+    private:
+
+        struct Point {
+            Point(const int dimension) : position(dimension), momentum(dimension), gradient(dimension),
+                                         logDensity(0.0), potential(0.0) { }
+
+            std::vector<double> position;
+            std::vector<double> momentum;
+            std::vector<double> gradient;
+            double logDensity;
+            double potential;
+        };
+
+        struct Tree {
+            Point minus;
+            Point plus;
+            Point proposal;
+            double count;
+            bool keepGoing;
+            double alpha;
+            double alphaCount;
+        };
+
+        void setParameters(const std::vector<double>& position) {
+            for (int k = 0; k < dimension; ++k) {
+                parameters[indices[k]] = std::exp(position[k]);
+            }
+        }
+
+        // Log-posterior and its gradient in log-parameter space, including the Jacobian
+        void evaluate(Point& point) {
+
+            setParameters(point.position);
+            engine.setParameters(parameters.data(), parameterCount);
+
+            double logLikelihood;
+            std::array<double, parameterCount> gradient;
+            engine.evaluateAll(&logLikelihood, gradient.data(), nullptr);
+            ++evaluations;
+
+            const double prior = logPrior(parameters.data());
+
+            point.potential = -logLikelihood - prior;
+            point.logDensity = logLikelihood + prior;
+
+            for (int k = 0; k < dimension; ++k) {
+                const int i = indices[k];
+                point.logDensity += point.position[k];
+                point.gradient[k] = parameters[i] *
+                        logPosteriorDerivative(i, parameters.data(), gradient.data()) + 1.0;
+            }
+
+            if (!(std::abs(point.logDensity) < INFINITY)) { // NaN or infinite
+                point.logDensity = -INFINITY;
+            }
+        }
+
+        void leapfrog(Point& point, const double epsilon) {
+            for (int k = 0; k < dimension; ++k) {
+                point.momentum[k] += 0.5 * epsilon * point.gradient[k];
+                point.position[k] += epsilon * point.momentum[k];
+            }
+            evaluate(point);
+            for (int k = 0; k < dimension; ++k) {
+                point.momentum[k] += 0.5 * epsilon * point.gradient[k];
+            }
+        }
+
+        double joint(const Point& point) const {
+            double kinetic = 0.0;
+            for (const auto r : point.momentum) {
+                kinetic += r * r;
+            }
+            return point.logDensity - 0.5 * kinetic;
+        }
+
+        bool noUTurn(const Point& minus, const Point& plus) const {
+            double forward = 0.0;
+            double backward = 0.0;
+            for (int k = 0; k < dimension; ++k) {
+                const double difference = plus.position[k] - minus.position[k];
+                forward += difference * plus.momentum[k];
+                backward += difference * minus.momentum[k];
+            }
+            return forward >= 0.0 && backward >= 0.0;
+        }
+
+        Tree buildTree(const Point& start, const double logU, const int direction, const int depth,
+                       const double joint0) {
+
+            if (depth == 0) {
+                Point point = start;
+                leapfrog(point, direction * stepSize);
+                const double energy = joint(point);
+                return Tree{ point, point, point,
+                             logU <= energy ? 1.0 : 0.0,
+                             logU < energy + maxEnergyError,
+                             std::min(1.0, std::exp(energy - joint0)),
+                             1.0 };
+            }
+
+            Tree tree = buildTree(start, logU, direction, depth - 1, joint0);
+            if (tree.keepGoing) {
+                Tree other = direction == -1 ?
+                             buildTree(tree.minus, logU, direction, depth - 1, joint0) :
+                             buildTree(tree.plus, logU, direction, depth - 1, joint0);
+
+                if (direction == -1) {
+                    tree.minus = other.minus;
+                } else {
+                    tree.plus = other.plus;
+                }
+
+                const double total = tree.count + other.count;
+                if (total > 0.0 && uniform(prng) < other.count / total) {
+                    tree.proposal = other.proposal;
+                }
+
+                tree.alpha += other.alpha;
+                tree.alphaCount += other.alphaCount;
+                tree.keepGoing = other.keepGoing && noUTurn(tree.minus, tree.plus);
+                tree.count = total;
+            }
+            return tree;
+        }
+
+        double findReasonableStepSize(const Point& start) {
+
+            double epsilon = 1.0;
+            Point point = start;
+            for (auto& r : point.momentum) {
+                r = normal(prng);
+            }
+            const double joint0 = joint(point);
+
+            auto logRatio = [&](const double epsilon) {
+                Point next = point;
+                leapfrog(next, epsilon);
+                return joint(next) - joint0;
+            };
+
+            double ratio = logRatio(epsilon);
+            const double a = ratio > std::log(0.5) ? 1.0 : -1.0;
+            while (a * ratio > -a * std::log(2.0) && epsilon > 1e-8 && epsilon < 1e8) {
+                epsilon *= std::pow(2.0, a);
+                ratio = logRatio(epsilon);
+            }
+            return epsilon;
+        }
+
+        static constexpr double maxEnergyError = 1000.0;
+
+        AbstractHawkes& engine;
+        const std::vector<int> indices;
+        const int dimension;
+        std::array<double, parameterCount> parameters;
+
+        std::mt19937_64 prng;
+        std::normal_distribution<double> normal;
+        std::uniform_real_distribution<double> uniform;
+
+        const double targetAcceptance;
+        const int maxDepth;
+        double stepSize;
+        long evaluations;
+    };
+
+    // Parallel tempering over chains at the given inverse temperatures (the first is the target, usually 1).
+    // Every chain makes one random-scan move per iteration and all proposals are evaluated together by a single
+    // getSumOfLikContribsBatch() sweep, so the pair work is shared across temperatures; an adjacent pair of
+    // chains then attempts to swap states. Only the likelihood is tempered.
+    class TemperingSampler {
+    public:
+
+        static const int parameterCount = 6;
+
+        TemperingSampler(AbstractHawkes& engine, const std::vector<double>& inverseTemperatures,
+                         const double radius, const unsigned long seed)
+            : engine(engine), inverseTemperatures(inverseTemperatures),
+              chainCount(static_cast<int>(inverseTemperatures.size())), prng(seed),
+              radii(chainCount, RadiusAdaptation(radius)),
+              accepted(chainCount, 0), proposed(0), swapsAccepted(0), swapsProposed(0) { }
+
+        // Writes (iterations - burnIn) x 6 draws of the first chain into samples and their untempered potential
+        // (negative log-posterior) into potentials, if not null
+        void run(const double* initial, const int iterations, const int burnIn,
+                 double* samples, double* potentials) {
+
+            std::vector<double> states(chainCount * parameterCount);
+            for (int chain = 0; chain < chainCount; ++chain) {
+                std::copy(initial, initial + parameterCount, states.begin() + chain * parameterCount);
+            }
+
+            std::vector<double> logLikelihoods(chainCount);
+            std::vector<double> logPriors(chainCount, logPrior(initial));
+            engine.getSumOfLikContribsBatch(states.data(), chainCount, logLikelihoods.data(), nullptr);
+
+            std::vector<double> proposals(chainCount * parameterCount);
+            std::vector<double> proposedLogLikelihoods(chainCount);
+            std::vector<int> indices(chainCount);
+            std::vector<double> logProposalRatios(chainCount);
+
+            std::uniform_real_distribution<double> uniform(0.0, 1.0);
+            std::uniform_int_distribution<int> choosePair(0, std::max(chainCount - 2, 0));
+
+            for (int iteration = 1; iteration <= iterations; ++iteration) {
+
+                ++proposed;
+
+                proposals = states;
+                for (int chain = 0; chain < chainCount; ++chain) {
+                    indices[chain] = chooseScanIndex(prng);
+                    logProposalRatios[chain] = proposeUnivariate(proposals.data() + chain * parameterCount,
+                            indices[chain], radii[chain][indices[chain]], prng);
+                }
+
+                engine.getSumOfLikContribsBatch(proposals.data(), chainCount,
+                                                proposedLogLikelihoods.data(), nullptr);
+
+                for (int chain = 0; chain < chainCount; ++chain) {
+                    const double* proposal = proposals.data() + chain * parameterCount;
+                    const double proposedLogPrior = logPrior(proposal);
+
+                    const double logRatio =
+                            inverseTemperatures[chain] * (proposedLogLikelihoods[chain] - logLikelihoods[chain]) +
+                            proposedLogPrior - logPriors[chain] + logProposalRatios[chain];
+
+                    const bool accept = logRatio > std::log(uniform(prng));
+                    if (accept) {
+                        std::copy(proposal, proposal + parameterCount, states.begin() + chain * parameterCount);
+                        logLikelihoods[chain] = proposedLogLikelihoods[chain];
+                        logPriors[chain] = proposedLogPrior;
+                        ++accepted[chain];
+                    }
+
+                    radii[chain].update(indices[chain], accept);
+                }
+
+                if (chainCount > 1) {
+                    ++swapsProposed;
+
+                    const int pair = choosePair(prng);
+                    const double logRatio = (inverseTemperatures[pair] - inverseTemperatures[pair + 1]) *
+                                            (logLikelihoods[pair + 1] - logLikelihoods[pair]);
+
+                    if (logRatio > std::log(uniform(prng))) {
+                        std::swap_ranges(states.begin() + pair * parameterCount,
+                                         states.begin() + (pair + 1) * parameterCount,
+                                         states.begin() + (pair + 1) * parameterCount);
+                        std::swap(logLikelihoods[pair], logLikelihoods[pair + 1]);
+                        std::swap(logPriors[pair], logPriors[pair + 1]);
+                        ++swapsAccepted;
+                    }
+                }
+
+                if (iteration > burnIn) {
+                    const int sample = iteration - burnIn - 1;
+                    std::copy(states.begin(), states.begin() + parameterCount, samples + sample * parameterCount);
+                    if (potentials != nullptr) {
+                        potentials[sample] = -logLikelihoods[0] - logPriors[0];
+                    }
+                }
+            }
+        }
+
+        double getAcceptanceRate(const int chain) const {
+            return proposed > 0 ? static_cast<double>(accepted[chain]) / proposed : 0.0;
+        }
+
+        double getSwapAcceptanceRate() const {
+            return swapsProposed > 0 ? static_cast<double>(swapsAccepted) / swapsProposed : 0.0;
+        }
+
+        int getChainCount() const {
+            return chainCount;
+        }
+
+    private:
+        AbstractHawkes& engine;
+        const std::vector<double> inverseTemperatures;
+        const int chainCount;
+
+        std::mt19937_64 prng;
+        std::vector<RadiusAdaptation> radii;
+
+        std::vector<long> accepted;
+        long proposed;
+        long swapsAccepted;
+        long swapsProposed;
+    };
+
+} // namespace hph
+
+#endif // _SAMPLER_HPP
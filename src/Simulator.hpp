@@ -0,0 +1,201 @@
+#ifndef _SIMULATOR_HPP
+#define _SIMULATOR_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "tbb/blocked_range.h"
+#include "tbb/parallel_for.h"
+#include "tbb/parallel_sort.h"
+#include "tbb/task_arena.h"
+
+#ifdef RBUILD
+#include <Rcpp.h>
+#endif
+
+namespace hph {
+
+    // Simulates the Hawkes model through its branching (cluster) representation, with the parameter order of
+    // AbstractHawkes::setParameters(). Immigrants mirror the model's background: every background centre, uniform
+    // in time over [0, horizon] and Normal(0, spread^2 I) in space, yields Poisson(mu0) immigrants displaced by
+    // Normal(0, 1 / tauXprec^2 I) and Normal(0, 1 / tauTprec^2). Each event has Poisson(theta) offspring after
+    // Exponential(omega) delays and Normal(0, 1 / sigmaXprec^2 I) displacements. Clusters are simulated in
+    // parallel in fixed blocks, each with its own generator, so results do not depend on the thread count.
+    class HawkesSimulator {
+    public:
+
+        HawkesSimulator(const int embeddingDimension, const double* parameters, const unsigned long seed,
+                        const double spread = 1.0, const int threads = 0)
+            : embeddingDimension(embeddingDimension),
+              sigmaXprec(parameters[0]), tauXprec(parameters[1]), tauTprec(parameters[2]),
+              omega(parameters[3]), theta(parameters[4]), mu0(parameters[5]),
+              seed(seed), spread(spread),
+              arena(threads > 0 ? threads : tbb::task_arena::automatic) {
+
+            if (!(theta < 1.0)) {
+#ifdef RBUILD
+                Rcpp::stop("Branching ratio theta must be less than 1 to simulate");
+#else
+                std::cerr << "Branching ratio theta must be less than 1 to simulate" << std::endl;
+                exit(-1);
+#endif
+            }
+        }
+
+        // Events with times in [0, horizon] from centreCount background centres, sorted by time; locations are
+        // row-major with embeddingDimension columns
+        void simulate(const int centreCount, const double horizon,
+                      std::vector<double>& times, std::vector<double>& locations) {
+
+            const int blockCount = (centreCount + blockSize - 1) / blockSize;
+            std::vector<Events> blocks(blockCount);
+
+            arena.execute([&]() {
+                tbb::parallel_for(tbb::blocked_range<int>(0, blockCount), [&](const tbb::blocked_range<int>& range) {
+                    for (int block = range.begin(); block < range.end(); ++block) {
+                        const int begin = block * blockSize;
+                        const int end = std::min(begin + blockSize, centreCount);
+                        simulateBlock(block, end - begin, horizon, blocks[block]);
+                    }
+                });
+            });
+
+            std::vector<size_t> offsets(blockCount + 1, 0);
+            for (int block = 0; block < blockCount; ++block) {
+                offsets[block + 1] = offsets[block] + blocks[block].times.size();
+            }
+            const size_t eventCount = offsets[blockCount];
+
+            std::vector<double> unsortedTimes(eventCount);
+            std::vector<double> unsortedLocations(eventCount * embeddingDimension);
+            std::vector<size_t> order(eventCount);
+
+            arena.execute([&]() {
+                tbb::parallel_for(0, blockCount, [&](const int block) {
+                    const auto& events = blocks[block];
+                    std::copy(events.times.begin(), events.times.end(), unsortedTimes.begin() + offsets[block]);
+                    std::copy(events.locations.begin(), events.locations.end(),
+                              unsortedLocations.begin() + offsets[block] * embeddingDimension);
+                    std::iota(order.begin() + offsets[block], order.begin() + offsets[block + 1], offsets[block]);
+                });
+
+                tbb::parallel_sort(order.begin(), order.end(), [&](const size_t lhs, const size_t rhs) {
+                    return unsortedTimes[lhs] < unsortedTimes[rhs] ||
+                           (unsortedTimes[lhs] == unsortedTimes[rhs] && lhs < rhs);
+                });
+
+                times.resize(eventCount);
+                locations.resize(eventCount * embeddingDimension);
+                tbb::parallel_for(size_t(0), eventCount, [&](const size_t i) {
+                    times[i] = unsortedTimes[order[i]];
+                    std::copy(unsortedLocations.begin() + order[i] * embeddingDimension,
+                              unsortedLocations.begin() + (order[i] + 1) * embeddingDimension,
+                              locations.begin() + i * embeddingDimension);
+                });
+            });
+        }
+
+        // The earliest eventCount events of a simulation on a horizon of about that many background centres,
+        // lengthened until enough events fall inside it
+        void simulate(const int eventCount, std::vector<double>& times, std::vector<double>& locations) {
+
+            const double eventsPerCentre = mu0 / (1.0 - theta);
+            double centres = std::ceil(1.1 * eventCount / std::max(eventsPerCentre, 1e-3)) + 1.0;
+
+            do {
+                simulate(static_cast<int>(centres), centres, times, locations);
+                centres *= 2.0;
+            } while (static_cast<int>(times.size()) < eventCount);
+
+            times.resize(eventCount);
+            locations.resize(static_cast<size_t>(eventCount) * embeddingDimension);
+        }
+
+    private:
+
+        struct Events {
+            std::vector<double> times;
+            std::vector<double> locations;
+        };
+
+        void simulateBlock(const int block, const int centreCount, const double horizon, Events& events) const {
+
+            std::seed_seq sequence{seed, static_cast<unsigned long>(block)};
+            std::mt19937_64 prng(sequence);
+
+            std::uniform_real_distribution<double> uniform(0.0, horizon);
+            std::normal_distribution<double> normal(0.0, 1.0);
+            std::exponential_distribution<double> delay(omega);
+            std::poisson_distribution<int> immigrants(mu0);
+            std::poisson_distribution<int> offspring(theta);
+
+            const int stride = embeddingDimension + 1;
+
+            std::vector<double> centre(embeddingDimension);
+            std::vector<double> event(stride);
+            std::vector<double> pending; // Events whose offspring are still to be drawn: time then location
+
+            for (int c = 0; c < centreCount; ++c) {
+
+                const double centreTime = uniform(prng);
+                for (auto& x : centre) {
+                    x = spread * normal(prng);
+                }
+
+                const int immigrantCount = immigrants(prng);
+                for (int m = 0; m < immigrantCount; ++m) {
+                    pending.push_back(centreTime + normal(prng) / tauTprec);
+                    for (int d = 0; d < embeddingDimension; ++d) {
+                        pending.push_back(centre[d] + normal(prng) / tauXprec);
+                    }
+                }
+
+                while (!pending.empty()) {
+                    const size_t top = pending.size() - stride;
+                    const double time = pending[top];
+                    if (time > horizon) { // Neither it nor its descendants are kept
+                        pending.resize(top);
+                        continue;
+                    }
+
+                    std::copy(pending.begin() + top, pending.end(), event.begin());
+                    pending.resize(top);
+
+                    if (time >= 0.0) {
+                        events.times.push_back(time);
+                        events.locations.insert(events.locations.end(), event.begin() + 1, event.end());
+                    }
+
+                    const int childCount = offspring(prng);
+                    for (int k = 0; k < childCount; ++k) {
+                        pending.push_back(time + delay(prng));
+                        for (int d = 0; d < embeddingDimension; ++d) {
+                            pending.push_back(event[1 + d] + normal(prng) / sigmaXprec);
+                        }
+                    }
+                }
+            }
+        }
+
+        static const int blockSize = 256;
+
+        const int embeddingDimension;
+        const double sigmaXprec;
+        const double tauXprec;
+        const double tauTprec;
+        const double omega;
+        const double theta;
+        const double mu0;
+
+        const unsigned long seed;
+        const double spread;
+        tbb::task_arena arena;
+    };
+
+} // namespace hph
+
+#endif // _SIMULATOR_HPP
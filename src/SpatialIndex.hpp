@@ -0,0 +1,259 @@
+#ifndef _SPATIAL_INDEX_HPP
+#define _SPATIAL_INDEX_HPP
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+
+#include "MemoryManagement.hpp"
+#include "isa.h"
+
+namespace hph {
+HPH_ISA_NAMESPACE_BEGIN
+
+    // Uniform grid over the bounding box of 2-dimensional locations
+    template <typename RealType>
+    class UniformGrid {
+    public:
+
+        void build(const RealType* locations, const int count, const RealType radius) {
+
+            builtRadius = radius;
+
+            if (count == 0) { // No cells, so forEachNeighbour() visits nothing
+                cellCount[0] = cellCount[1] = 0;
+                cellStart.assign(1, 0);
+                points.resize(0);
+                return;
+            }
+
+            lower[0] = upper[0] = locations[0];
+            lower[1] = upper[1] = locations[1];
+            for (int i = 1; i < count; ++i) {
+                for (int d = 0; d < 2; ++d) {
+                    lower[d] = std::min(lower[d], locations[i * 2 + d]);
+                    upper[d] = std::max(upper[d], locations[i * 2 + d]);
+                }
+            }
+
+            // Cells are at least one cut-off radius wide, but never more numerous than ~4 per point
+            const auto width = std::max(upper[0] - lower[0], upper[1] - lower[1]);
+            cellSize = std::max(radius, width / std::sqrt(RealType(4 * count)));
+            if (!(cellSize > RealType(0))) {
+                cellSize = RealType(1);
+            }
+
+            cellCount[0] = static_cast<int>((upper[0] - lower[0]) / cellSize) + 1;
+            cellCount[1] = static_cast<int>((upper[1] - lower[1]) / cellSize) + 1;
+
+            // Counting sort of points into cells
+            cellStart.assign(cellCount[0] * cellCount[1] + 1, 0);
+            mm::MemoryManager<int> cells(count);
+            for (int i = 0; i < count; ++i) {
+                cells[i] = cellIndex(cellOf(locations[i * 2], 0), cellOf(locations[i * 2 + 1], 1));
+                ++cellStart[cells[i] + 1];
+            }
+            std::partial_sum(cellStart.begin(), cellStart.end(), cellStart.begin());
+
+            points.resize(count);
+            mm::MemoryManager<int> fill(cellStart.begin(), cellStart.end() - 1);
+            for (int i = 0; i < count; ++i) {
+                points[fill[cells[i]]++] = i;
+            }
+        }
+
+        bool isSuitable(const RealType radius) const {
+            return radius <= 2 * builtRadius && radius >= builtRadius / 2;
+        }
+
+        template <typename Function>
+        void forEachNeighbour(const RealType* locations, const int i, const RealType radius,
+                              Function function) const {
+
+            const auto x = locations[i * 2];
+            const auto y = locations[i * 2 + 1];
+            const auto radius2 = radius * radius;
+            const int reach = static_cast<int>(std::ceil(radius / cellSize));
+
+            const int cx = cellOf(x, 0);
+            const int cy = cellOf(y, 1);
+
+            for (int ix = std::max(cx - reach, 0); ix <= std::min(cx + reach, cellCount[0] - 1); ++ix) {
+                for (int iy = std::max(cy - reach, 0); iy <= std::min(cy + reach, cellCount[1] - 1); ++iy) {
+                    const int cell = cellIndex(ix, iy);
+                    for (int k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+                        const int j = points[k];
+                        const auto dx = x - locations[j * 2];
+                        const auto dy = y - locations[j * 2 + 1];
+                        const auto distance2 = dx * dx + dy * dy;
+                        if (distance2 <= radius2) {
+                            function(j, std::sqrt(distance2));
+                        }
+                    }
+                }
+            }
+        }
+
+    private:
+
+        int cellOf(const RealType x, const int d) const {
+            const int cell = static_cast<int>((x - lower[d]) / cellSize);
+            return std::min(std::max(cell, 0), cellCount[d] - 1);
+        }
+
+        int cellIndex(const int ix, const int iy) const {
+            return ix * cellCount[1] + iy;
+        }
+
+        RealType lower[2];
+        RealType upper[2];
+        RealType cellSize;
+        RealType builtRadius;
+        int cellCount[2];
+
+        mm::MemoryManager<int> cellStart;
+        mm::MemoryManager<int> points;
+    };
+
+    // Implicit (median-split) k-d tree for arbitrary dimension
+    template <typename RealType>
+    class KdTree {
+    public:
+
+        KdTree(const int embeddingDimension) : embeddingDimension(embeddingDimension) { }
+
+        void build(const RealType* locations, const int count, const RealType) {
+            order.resize(count);
+            std::iota(order.begin(), order.end(), 0);
+            buildNode(locations, 0, count, 0);
+        }
+
+        bool isSuitable(const RealType) const {
+            return true;
+        }
+
+        template <typename Function>
+        void forEachNeighbour(const RealType* locations, const int i, const RealType radius,
+                              Function function) const {
+            queryNode(locations, locations + i * embeddingDimension, radius * radius, radius,
+                      0, static_cast<int>(order.size()), 0, function);
+        }
+
+    private:
+
+        static const int leafSize = 8;
+
+        void buildNode(const RealType* locations, const int begin, const int end, const int depth) {
+            if (end - begin <= leafSize) {
+                return;
+            }
+
+            const int axis = depth % embeddingDimension;
+            const int middle = begin + (end - begin) / 2;
+
+            std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                             [locations, axis, this](const int lhs, const int rhs) {
+                                 return locations[lhs * embeddingDimension + axis] <
+                                        locations[rhs * embeddingDimension + axis];
+                             });
+
+            buildNode(locations, begin, middle, depth + 1);
+            buildNode(locations, middle + 1, end, depth + 1);
+        }
+
+        RealType distance2(const RealType* locations, const RealType* x, const int j) const {
+            RealType sum = 0;
+            const RealType* y = locations + j * embeddingDimension;
+            for (int d = 0; d < embeddingDimension; ++d) {
+                const auto diff = x[d] - y[d];
+                sum += diff * diff;
+            }
+            return sum;
+        }
+
+        template <typename Function>
+        void queryNode(const RealType* locations, const RealType* x, const RealType radius2,
+                       const RealType radius, const int begin, const int end, const int depth,
+                       Function& function) const {
+
+            if (end - begin <= leafSize) {
+                for (int k = begin; k < end; ++k) {
+                    const auto d2 = distance2(locations, x, order[k]);
+                    if (d2 <= radius2) {
+                        function(order[k], std::sqrt(d2));
+                    }
+                }
+                return;
+            }
+
+            const int axis = depth % embeddingDimension;
+            const int middle = begin + (end - begin) / 2;
+            const int j = order[middle];
+            const auto split = locations[j * embeddingDimension + axis];
+
+            const auto d2 = distance2(locations, x, j);
+            if (d2 <= radius2) {
+                function(j, std::sqrt(d2));
+            }
+
+            if (x[axis] - radius <= split) {
+                queryNode(locations, x, radius2, radius, begin, middle, depth + 1, function);
+            }
+            if (x[axis] + radius >= split) {
+                queryNode(locations, x, radius2, radius, middle + 1, end, depth + 1, function);
+            }
+        }
+
+        const int embeddingDimension;
+        mm::MemoryManager<int> order;
+    };
+
+    // Grid for D = 2, k-d tree otherwise
+    template <typename RealType>
+    class SpatialIndex {
+    public:
+
+        SpatialIndex(const int embeddingDimension) : embeddingDimension(embeddingDimension),
+                tree(embeddingDimension), built(false) { }
+
+        void build(const RealType* locations, const int count, const RealType radius) {
+            if (embeddingDimension == 2) {
+                grid.build(locations, count, radius);
+            } else {
+                tree.build(locations, count, radius);
+            }
+            built = true;
+        }
+
+        void invalidate() {
+            built = false;
+        }
+
+        bool isValid(const RealType radius) const {
+            return built && (embeddingDimension == 2 ? grid.isSuitable(radius) : tree.isSuitable(radius));
+        }
+
+        // Calls function(j, distance) for every location j within radius of location i
+        template <typename Function>
+        void forEachNeighbour(const RealType* locations, const int i, const RealType radius,
+                              Function function) const {
+            if (embeddingDimension == 2) {
+                grid.forEachNeighbour(locations, i, radius, function);
+            } else {
+                tree.forEachNeighbour(locations, i, radius, function);
+            }
+        }
+
+    private:
+        const int embeddingDimension;
+        UniformGrid<RealType> grid;
+        KdTree<RealType> tree;
+        bool built;
+    };
+
+HPH_ISA_NAMESPACE_END
+} // namespace hph
+
+#endif // _SPATIAL_INDEX_HPP
@@ -0,0 +1,182 @@
+#ifndef _STATE_FILE_HPP
+#define _STATE_FILE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef RBUILD
+#include <Rcpp.h>
+#endif
+
+#include "EventFile.hpp"
+#include "isa.h"
+
+namespace hph {
+HPH_ISA_NAMESPACE_BEGIN
+
+    // Engine snapshot, in native byte order: a 64-byte header, a table of sectionCount (offset, bytes) entries
+    // and the sections themselves, each starting at a 64-byte aligned offset. Which sections exist and what
+    // they hold is up to the engine that wrote the file; realSize records its floating-point width.
+    struct StateFileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t embeddingDimension;
+        std::uint64_t locationCount;
+        std::uint32_t realSize;
+        std::uint32_t sectionCount;
+        char padding[32];
+    };
+
+    static_assert(sizeof(StateFileHeader) == 64, "State file header must be 64 bytes");
+
+    struct StateFileSection {
+        std::uint64_t offset;
+        std::uint64_t bytes;
+    };
+
+    namespace statefile {
+
+        static const char magic[8] = {'H', 'P', 'H', 'S', 'T', 'A', 'T', 'E'};
+        static const std::uint32_t version = 1;
+
+        inline void fail(const std::string& message) {
+#ifdef RBUILD
+            Rcpp::stop(message);
+#else
+            std::cerr << message << std::endl;
+            exit(-1);
+#endif
+        }
+
+    } // namespace statefile
+
+    // Collects sections by reference and writes them out in order
+    class StateFileWriter {
+    public:
+
+        StateFileWriter(const int embeddingDimension, const int locationCount, const std::size_t realSize) {
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, statefile::magic, sizeof(header.magic));
+            header.version = statefile::version;
+            header.embeddingDimension = static_cast<std::uint32_t>(embeddingDimension);
+            header.locationCount = static_cast<std::uint64_t>(locationCount);
+            header.realSize = static_cast<std::uint32_t>(realSize);
+        }
+
+        template <typename T>
+        void add(const T* data, const std::size_t count) {
+            sections.emplace_back(reinterpret_cast<const char*>(data), count * sizeof(T));
+        }
+
+        void write(const std::string& path) {
+
+            header.sectionCount = static_cast<std::uint32_t>(sections.size());
+
+            mm::MemoryManager<StateFileSection> table(sections.size());
+            std::uint64_t offset = eventfile::align(sizeof(header) + table.size() * sizeof(StateFileSection));
+            for (std::size_t i = 0; i < sections.size(); ++i) {
+                table[i] = StateFileSection{ offset, sections[i].second };
+                offset = eventfile::align(offset + sections[i].second);
+            }
+
+            // Write next to the target and rename, so a pre-empted save never leaves a truncated snapshot
+            const std::string temporary = path + ".tmp";
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                statefile::fail("Unable to open state file " + temporary + " for writing");
+            }
+
+            const mm::MemoryManager<char> zeros(eventfile::alignment, 0);
+            auto pad = [&file, &zeros](const std::uint64_t offset) {
+                file.write(zeros.data(), offset - static_cast<std::uint64_t>(file.tellp()));
+            };
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(StateFileSection));
+            for (std::size_t i = 0; i < sections.size(); ++i) {
+                pad(table[i].offset);
+                file.write(sections[i].first, sections[i].second);
+            }
+            file.close();
+
+            if (!file || std::rename(temporary.c_str(), path.c_str()) != 0) {
+                statefile::fail("Unable to write state file " + path);
+            }
+        }
+
+    private:
+        StateFileHeader header;
+        mm::MemoryManager<std::pair<const char*, std::uint64_t>> sections;
+    };
+
+    class MappedStateFile {
+    public:
+
+        explicit MappedStateFile(const std::string& path) : file(path), path(path) {
+            if (file.size() < sizeof(StateFileHeader)) {
+                statefile::fail("Invalid state file " + path);
+            }
+
+            std::memcpy(&header, file.data(), sizeof(header));
+            if (std::memcmp(header.magic, statefile::magic, sizeof(header.magic)) != 0 ||
+                header.version != statefile::version ||
+                sizeof(header) + header.sectionCount * sizeof(StateFileSection) > file.size()) {
+                statefile::fail("Invalid state file " + path);
+            }
+
+            table.resize(header.sectionCount);
+            std::memcpy(table.data(), file.data() + sizeof(header), table.size() * sizeof(StateFileSection));
+            for (const auto& section : table) {
+                if (section.offset % eventfile::alignment != 0 || section.offset + section.bytes > file.size()) {
+                    statefile::fail("Invalid state file " + path);
+                }
+            }
+        }
+
+        int getEmbeddingDimension() const {
+            return static_cast<int>(header.embeddingDimension);
+        }
+
+        int getLocationCount() const {
+            return static_cast<int>(header.locationCount);
+        }
+
+        std::size_t getRealSize() const {
+            return header.realSize;
+        }
+
+        int getSectionCount() const {
+            return static_cast<int>(header.sectionCount);
+        }
+
+        template <typename T>
+        std::size_t getLength(const int index) const {
+            return static_cast<std::size_t>(table[index].bytes / sizeof(T));
+        }
+
+        // Section index as an array of count Ts
+        template <typename T>
+        const T* get(const int index, const std::size_t count) const {
+            if (index >= getSectionCount() || table[index].bytes != count * sizeof(T)) {
+                statefile::fail("State file " + path + " does not match the engine");
+            }
+            return reinterpret_cast<const T*>(file.data() + table[index].offset);
+        }
+
+    private:
+        MappedFile file;
+        std::string path;
+        StateFileHeader header;
+        mm::MemoryManager<StateFileSection> table;
+    };
+
+HPH_ISA_NAMESPACE_END
+} // namespace hph
+
+#endif // _STATE_FILE_HPP
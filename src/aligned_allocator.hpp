@@ -9,7 +9,10 @@
 #include <stdlib.h>
 #include <memory>
 
+#include "isa.h"
+
 namespace util {
+HPH_ISA_NAMESPACE_BEGIN
 
 /**
  * STL-compliant allocator that allocates aligned memory.
@@ -114,6 +117,7 @@ bool operator != (const aligned_allocator<T1,A1> &, const aligned_allocator<T2,A
         return false;
 }
 
+HPH_ISA_NAMESPACE_END
 } // namespace util
 
 #endif // UTILITIES_ALIGNED_ALLOCATOR_HPP
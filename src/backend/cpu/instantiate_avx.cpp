@@ -0,0 +1,47 @@
+// AVX engines; built with AVX flags and only constructed by factory() on CPUs that support them
+#ifdef USE_AVX
+
+#define HPH_ISA avx // Distinct symbols for everything compiled here; see isa.h
+#include "NewHawkes.hpp"
+
+namespace hph {
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesDoubleNoParallelAvx(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "DOUBLE, NO PARALLEL, AVX" << std::endl;
+        return std::make_shared<NewHawkes<DoubleAvxTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesDoubleTbbAvx(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "DOUBLE, TBB PARALLEL, AVX" << std::endl;
+        return std::make_shared<NewHawkes<DoubleAvxTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesFloatNoParallelAvx(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "SINGLE, NO PARALLEL, AVX" << std::endl;
+        return std::make_shared<NewHawkes<FloatAvxTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesFloatTbbAvx(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "SINGLE, TBB PARALLEL, AVX" << std::endl;
+        return std::make_shared<NewHawkes<FloatAvxTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesMixedNoParallelAvx(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "MIXED, NO PARALLEL, AVX" << std::endl;
+        return std::make_shared<NewHawkes<FloatMixedAvxTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesMixedTbbAvx(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "MIXED, TBB PARALLEL, AVX" << std::endl;
+        return std::make_shared<NewHawkes<FloatMixedAvxTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+} // namespace hph
+
+#endif // USE_AVX
@@ -0,0 +1,47 @@
+// AVX-512 engines; built with AVX-512 flags and only constructed by factory() on CPUs that support them
+#ifdef USE_AVX512
+
+#define HPH_ISA avx512 // Distinct symbols for everything compiled here; see isa.h
+#include "NewHawkes.hpp"
+
+namespace hph {
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesDoubleNoParallelAvx512(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "DOUBLE, NO PARALLEL, AVX512" << std::endl;
+        return std::make_shared<NewHawkes<DoubleAvx512TypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesDoubleTbbAvx512(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "DOUBLE, TBB PARALLEL, AVX512" << std::endl;
+        return std::make_shared<NewHawkes<DoubleAvx512TypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesFloatNoParallelAvx512(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "SINGLE, NO PARALLEL, AVX512" << std::endl;
+        return std::make_shared<NewHawkes<FloatAvx512TypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesFloatTbbAvx512(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "SINGLE, TBB PARALLEL, AVX512" << std::endl;
+        return std::make_shared<NewHawkes<FloatAvx512TypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesMixedNoParallelAvx512(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "MIXED, NO PARALLEL, AVX512" << std::endl;
+        return std::make_shared<NewHawkes<FloatMixedAvx512TypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesMixedTbbAvx512(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "MIXED, TBB PARALLEL, AVX512" << std::endl;
+        return std::make_shared<NewHawkes<FloatMixedAvx512TypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+} // namespace hph
+
+#endif // USE_AVX512
@@ -0,0 +1,43 @@
+// Scalar engines; built without any SIMD flags, so they run on every CPU
+#define HPH_ISA nosimd // Distinct symbols for everything compiled here; see isa.h
+#include "NewHawkes.hpp"
+
+namespace hph {
+
+std::shared_ptr<AbstractHawkes>
+constructNewHawkesDoubleNoParallelNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
+	defaultOut << "DOUBLE, NO PARALLEL, NO SIMD" << std::endl;
+	return std::make_shared<NewHawkes<DoubleNoSimdTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+}
+
+std::shared_ptr<AbstractHawkes>
+constructNewHawkesDoubleTbbNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
+    defaultOut << "DOUBLE, TBB PARALLEL, NO SIMD" << std::endl;
+    return std::make_shared<NewHawkes<DoubleNoSimdTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+}
+
+std::shared_ptr<AbstractHawkes>
+constructNewHawkesFloatNoParallelNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
+    defaultOut << "SINGLE, NO PARALLEL, NO SIMD" << std::endl;
+    return std::make_shared<NewHawkes<FloatNoSimdTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+}
+
+std::shared_ptr<AbstractHawkes>
+constructNewHawkesFloatTbbNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
+    defaultOut << "SINGLE, TBB PARALLEL, NO SIMD" << std::endl;
+    return std::make_shared<NewHawkes<FloatNoSimdTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+}
+
+std::shared_ptr<AbstractHawkes>
+constructNewHawkesMixedNoParallelNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
+    defaultOut << "MIXED, NO PARALLEL, NO SIMD" << std::endl;
+    return std::make_shared<NewHawkes<FloatMixedNoSimdTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+}
+
+std::shared_ptr<AbstractHawkes>
+constructNewHawkesMixedTbbNoSimd(int embeddingDimension, int locationCount, long flags, int threads) {
+    defaultOut << "MIXED, TBB PARALLEL, NO SIMD" << std::endl;
+    return std::make_shared<NewHawkes<FloatMixedNoSimdTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+}
+
+} // namespace hph
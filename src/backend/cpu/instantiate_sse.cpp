@@ -0,0 +1,47 @@
+// SSE engines; built with SSE flags and only constructed by factory() on CPUs that support them
+#ifdef USE_SSE
+
+#define HPH_ISA sse // Distinct symbols for everything compiled here; see isa.h
+#include "NewHawkes.hpp"
+
+namespace hph {
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesDoubleNoParallelSse(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "DOUBLE, NO PARALLEL, SSE" << std::endl;
+        return std::make_shared<NewHawkes<DoubleSseTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesDoubleTbbSse(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "DOUBLE, TBB PARALLEL, SSE" << std::endl;
+        return std::make_shared<NewHawkes<DoubleSseTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+	std::shared_ptr<AbstractHawkes>
+	constructNewHawkesFloatNoParallelSse(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "SINGLE, NO PARALLEL, SSE" << std::endl;
+        return std::make_shared<NewHawkes<FloatSseTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+	}
+
+	std::shared_ptr<AbstractHawkes>
+	constructNewHawkesFloatTbbSse(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "SINGLE, TBB PARALLEL, SSE" << std::endl;
+        return std::make_shared<NewHawkes<FloatSseTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+	}
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesMixedNoParallelSse(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "MIXED, NO PARALLEL, SSE" << std::endl;
+        return std::make_shared<NewHawkes<FloatMixedSseTypeInfo, CpuAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+    std::shared_ptr<AbstractHawkes>
+    constructNewHawkesMixedTbbSse(int embeddingDimension, int locationCount, long flags, int threads) {
+        defaultOut << "MIXED, TBB PARALLEL, SSE" << std::endl;
+        return std::make_shared<NewHawkes<FloatMixedSseTypeInfo, TbbAccumulate>>(embeddingDimension, locationCount, flags, threads);
+    }
+
+} // namespace hph
+
+#endif // USE_SSE
@@ -57,6 +57,13 @@ public:
 
           sumOfLikContribs(0.0), storedSumOfLikContribs(0.0),
 
+          truncationTolerance(0.0),
+
+          likelihoodVersion{0, 0, 0},
+          gradientVersion{0, 0, 0},
+          probsVersion{0, 0, 0},
+          storedLikelihoodKnown(false),
+
           times(locationCount),
 
           likContribs(locationCount),
@@ -259,12 +266,50 @@ public:
                                          queue
         );
 
+        ++version.locations;
 //        sumOfIncrementsKnown = false;
     }
 
     int getInternalDimension() override { return OpenCLRealType::dim; }
 
     void getLogLikelihoodGradient(double* result, size_t length) override {
+        assert(length == 6);
+        if (gradientVersion != version) {
+            computeFused();
+        }
+        memcpy(result, fusedSums.data(), 48);
+    }
+
+    // One launch of the gradient kernel also yields the log-likelihood and the self-excitation probabilities
+    void evaluateAll(double* logLikelihood, double* gradient, double* probsSelfExcite) override {
+
+        if (likelihoodVersion != version ||
+            (gradient != nullptr && gradientVersion != version) ||
+            (probsSelfExcite != nullptr && probsVersion != version)) {
+            computeFused();
+        }
+
+        *logLikelihood = sumOfLikContribs;
+
+        if (gradient != nullptr) {
+            memcpy(gradient, fusedSums.data(), 48);
+        }
+
+        if (probsSelfExcite != nullptr) {
+            mm::bufferedCopyFromDevice<OpenCLRealType>(dProbsSelfExcite.begin(), dProbsSelfExcite.end(),
+                                                       probsSelfExcite, buffer, queue);
+            queue.finish();
+        }
+    }
+
+    void computeFused() {
+        fusedSums = computeFusedSums();
+        sumOfLikContribs = fusedSums[6] + locationCount*(embeddingDimension-1)*log(M_1_SQRT_2PI);
+        likelihoodVersion = gradientVersion = probsVersion = version;
+    }
+
+    // Scaled gradient in [0, 6) and unnormalized log-likelihood in [6]
+    std::vector<double> computeFusedSums() {
 
 #ifdef MICRO_BENCHMARK
         auto startTime = std::chrono::steady_clock::now();
@@ -281,6 +326,7 @@ public:
         kernelGradientVector.set_arg(8, static_cast<RealType>(mu0));
         kernelGradientVector.set_arg(9, boost::compute::int_(embeddingDimension));
         kernelGradientVector.set_arg(10, boost::compute::uint_(locationCount));
+        kernelGradientVector.set_arg(11, dProbsSelfExcite);
 
         queue.enqueue_1d_range_kernel(kernelGradientVector, 0,
                                       static_cast<unsigned int>(locationCount) * TPB, TPB);
@@ -339,19 +385,30 @@ public:
                                                    middleMan.data(), buffer, queue);
         queue.finish();
 
-        middleMan[0] *= theta * pow(sigmaXprec,embeddingDimension+1);
+        middleMan[0] *= theta * pow(sigmaXprec,embeddingDimension+1) * omega;
         middleMan[1] *= mu0 * pow(tauXprec,embeddingDimension+1) * tauTprec;
         middleMan[2] *= mu0 * tauTprec * tauTprec;
         middleMan[3] *= theta;
 
-        memcpy(result,middleMan.data(), 48);
-
+        return middleMan;
     }
 
 	void getProbsSelfExcite(double* result, size_t length) override {
 
         assert(length == locationCount);
 
+        if (probsVersion != version) {
+            computeProbsSelfExcite();
+            probsVersion = version;
+        }
+
+        mm::bufferedCopyFromDevice<OpenCLRealType>(dProbsSelfExcite.begin(), dProbsSelfExcite.end(),
+                                       result, buffer, queue);
+        queue.finish();
+ 	}
+
+    void computeProbsSelfExcite() {
+
         kernelProbsSelfExcite.set_arg(0, dLocations0);
         kernelProbsSelfExcite.set_arg(1, dTimes);
         kernelProbsSelfExcite.set_arg(2, dProbsSelfExcite);
@@ -367,19 +424,19 @@ public:
         queue.enqueue_1d_range_kernel(kernelProbsSelfExcite, 0,
                                       static_cast<unsigned int>(locationCount) * TPB, TPB);
         queue.finish();
-
-        mm::bufferedCopyFromDevice<OpenCLRealType>(dProbsSelfExcite.begin(), dProbsSelfExcite.end(),
-                                       result, buffer, queue);
-        queue.finish();
- 	}
+    }
 
     double getSumOfLikContribs() override {
-        computeSumOfLikContribs();
+        if (likelihoodVersion != version) {
+            computeSumOfLikContribs();
+            likelihoodVersion = version;
+        }
     	return sumOfLikContribs;
  	}
 
     void storeState() override {
     	storedSumOfLikContribs = sumOfLikContribs;
+    	storedLikelihoodKnown = likelihoodVersion == version;
         storedSigmaXprec = sigmaXprec;
         storedTauXprec = tauXprec;
         storedTauTprec = tauTprec;
@@ -439,6 +496,9 @@ public:
         dStoredLocationsPtr = dLocationsPtr;
         dLocationsPtr = tmp2;
 
+        ++version.parameters;
+        ++version.locations;
+        likelihoodVersion = storedLikelihoodKnown ? version : StateVersion{0, 0, 0};
     }
 
     void setTimesData(double* data, size_t length) override {
@@ -448,10 +508,21 @@ public:
         // COMPUTE
         mm::bufferedCopyToDevice(data, data + length, dTimes.begin(),
                                  buffer, queue);
+        ++version.times;
+    }
+
+    void shareEvents(const double* timesData, const double* locationsData, std::shared_ptr<const void>) override {
+        // Device buffers need a copy anyway
+        setTimesData(const_cast<double*>(timesData), locationCount);
+        updateLocations(-1, const_cast<double*>(locationsData), locationCount * embeddingDimension);
     }
 
     void setParameters(double* data, size_t length) override {
 		assert(length == 6);
+		if (data[0] != sigmaXprec || data[1] != tauXprec || data[2] != tauTprec || data[3] != omega ||
+		    data[4] != theta || data[5] != mu0) {
+		    ++version.parameters;
+		}
 		sigmaXprec = data[0];
 		tauXprec = data[1];
 		tauTprec = data[2];
@@ -460,6 +531,150 @@ public:
 		mu0 = data[5];
     }
 
+    // Host loop over the parameter sets; the device kernels take a single parameter vector
+    void getSumOfLikContribsBatch(const double* parameters, int count,
+                                  double* logLikelihoods, double* gradients) override {
+
+        double current[] = { sigmaXprec, tauXprec, tauTprec, omega, theta, mu0 };
+
+        for (int k = 0; k < count; ++k) {
+            std::vector<double> data(parameters + 6 * k, parameters + 6 * (k + 1));
+            setParameters(data.data(), 6);
+            logLikelihoods[k] = getSumOfLikContribs();
+            if (gradients != nullptr) {
+                getLogLikelihoodGradient(gradients + 6 * k, 6);
+            }
+        }
+
+        setParameters(current, 6);
+    }
+
+    // Device kernels always evaluate all pairs, so truncation is exact here
+    void setTruncation(double tolerance) override {
+        truncationTolerance = tolerance;
+    }
+
+    double getTruncationErrorBound() override { return 0.0; }
+
+    std::size_t getDistanceCacheFootprint() override { return 0; }
+
+    std::shared_ptr<AbstractHawkes> clone() override {
+#ifdef RBUILD
+        Rcpp::stop("Engine cloning is not supported on GPU");
+#else
+        std::cerr << "Engine cloning is not supported on GPU" << std::endl;
+        exit(-1);
+#endif
+    }
+
+    void limitThreads(bool limit) override { }
+
+    void appendEvents(double* times, double* locations, size_t count) override {
+#ifdef RBUILD
+        Rcpp::stop("Appending events is not supported on GPU");
+#else
+        std::cerr << "Appending events is not supported on GPU" << std::endl;
+        exit(-1);
+#endif
+    }
+
+    void setWindow(double length) override {
+        if (length > 0.0) {
+#ifdef RBUILD
+            Rcpp::stop("Sliding windows are not supported on GPU");
+#else
+            std::cerr << "Sliding windows are not supported on GPU" << std::endl;
+            exit(-1);
+#endif
+        }
+    }
+
+
+    // One work-group per query point, as in the likelihood kernels; truncation is ignored
+    void evaluateIntensity(double* queryLocations, double* queryTimes, size_t count,
+                           double* intensity, double* background, double* selfExcite) override {
+
+        if (count == 0) {
+            return;
+        }
+
+        mm::MemoryManager<RealType> queries(count * OpenCLRealType::dim);
+        mm::paddedBufferedCopy(queryLocations, embeddingDimension, embeddingDimension,
+                               begin(queries), OpenCLRealType::dim, count, buffer);
+
+        auto dQueries = mm::GPUMemoryManager<VectorType>(count, ctx);
+        auto dQueryTimes = mm::GPUMemoryManager<RealType>(count, ctx);
+        auto dBackground = mm::GPUMemoryManager<RealType>(count, ctx);
+        auto dSelfExcite = mm::GPUMemoryManager<RealType>(count, ctx);
+
+        mm::copyToDevice<OpenCLRealType>(begin(queries), end(queries), dQueries.begin(), queue);
+        mm::bufferedCopyToDevice(queryTimes, queryTimes + count, dQueryTimes.begin(), buffer, queue);
+
+        kernelIntensity.set_arg(0, *dLocationsPtr);
+        kernelIntensity.set_arg(1, dTimes);
+        kernelIntensity.set_arg(2, dQueries);
+        kernelIntensity.set_arg(3, dQueryTimes);
+        kernelIntensity.set_arg(4, dBackground);
+        kernelIntensity.set_arg(5, dSelfExcite);
+        kernelIntensity.set_arg(6, static_cast<RealType>(sigmaXprec));
+        kernelIntensity.set_arg(7, static_cast<RealType>(tauXprec));
+        kernelIntensity.set_arg(8, static_cast<RealType>(tauTprec));
+        kernelIntensity.set_arg(9, static_cast<RealType>(omega));
+        kernelIntensity.set_arg(10, static_cast<RealType>(theta));
+        kernelIntensity.set_arg(11, static_cast<RealType>(mu0));
+        kernelIntensity.set_arg(12, boost::compute::int_(embeddingDimension));
+        kernelIntensity.set_arg(13, boost::compute::uint_(locationCount));
+
+        queue.enqueue_1d_range_kernel(kernelIntensity, 0, static_cast<unsigned int>(count) * TPB, TPB);
+        queue.finish();
+
+        std::vector<double> backgroundSums(count);
+        std::vector<double> selfExciteSums(count);
+        mm::bufferedCopyFromDevice<OpenCLRealType>(dBackground.begin(), dBackground.end(),
+                                                   backgroundSums.data(), buffer, queue);
+        mm::bufferedCopyFromDevice<OpenCLRealType>(dSelfExcite.begin(), dSelfExcite.end(),
+                                                   selfExciteSums.data(), buffer, queue);
+        queue.finish();
+
+        const auto norm = pow(M_1_SQRT_2PI, embeddingDimension - 1);
+        for (size_t q = 0; q < count; ++q) {
+            intensity[q] = norm * (backgroundSums[q] + selfExciteSums[q]);
+            if (background != nullptr) {
+                background[q] = norm * backgroundSums[q];
+            }
+            if (selfExcite != nullptr) {
+                selfExcite[q] = norm * selfExciteSums[q];
+            }
+        }
+    }
+
+    void evaluateCompensator(double* lower, double* upper, double* startTimes, double* endTimes, size_t count,
+                             double* expected, double* background, double* selfExcite) override {
+#ifdef RBUILD
+        Rcpp::stop("Compensator evaluation is not supported on GPU");
+#else
+        std::cerr << "Compensator evaluation is not supported on GPU" << std::endl;
+        exit(-1);
+#endif
+    }
+
+    void saveState(const std::string& path, const double* extra, size_t extraLength) override {
+#ifdef RBUILD
+        Rcpp::stop("Checkpointing is not supported on GPU");
+#else
+        std::cerr << "Checkpointing is not supported on GPU" << std::endl;
+        exit(-1);
+#endif
+    }
+
+    void loadState(const std::string& path, std::vector<double>* extra) override {
+#ifdef RBUILD
+        Rcpp::stop("Checkpointing is not supported on GPU");
+#else
+        std::cerr << "Checkpointing is not supported on GPU" << std::endl;
+        exit(-1);
+#endif
+    }
 
 //    void makeDirty() override { // not sure this is needed
 ////    	sumOfLikContribsKnown = false;
@@ -1100,7 +1315,8 @@ public:
              "                                 const REAL theta,                       \n" <<
              "                                 const REAL mu0,                         \n" <<
              "                                 const int dimX,                         \n" <<
-             "						          const uint locationCount) {             \n";
+             "						          const uint locationCount,               \n" <<
+             "                                 __global REAL *probsSelfExcite) {       \n";
 
         code <<
              "   const uint i = get_group_id(0);                                     \n" <<
@@ -1132,7 +1348,7 @@ public:
              "   const REAL tauXprecD = pow(tauXprec, dimX);                             \n" <<
              "   const REAL tauTprec2 = tauTprec * tauTprec;                             \n" <<
              "   const REAL mu0TauXprecDTauTprec = mu0 * tauXprecD * tauTprec;           \n" <<
-             "   const REAL sigmaXprecDTheta = sigmaXprecD * theta;                      \n" <<
+             "   const REAL sigmaXprecDThetaOmega = sigmaXprecD * theta * omega;         \n" <<
              "                                                                       \n" <<
              "   while (j < locationCount) {                                         \n" << // originally j < locationCount
              "                                                                       \n" <<
@@ -1162,7 +1378,7 @@ public:
                 const REAL tauXrate = (tauXprec2 * locDist * locDist - dimX) * mu0Rate;
                 const REAL tauTrate = (tauTprec2 * timDiff * timDiff - ONE) * mu0Rate;
                 const REAL omegaRate = timDiff * thetaRate;
-                const REAL totalRate = mu0TauXprecDTauTprec * mu0Rate + sigmaXprecDTheta * thetaRate;
+                const REAL totalRate = mu0TauXprecDTauTprec * mu0Rate + sigmaXprecDThetaOmega * thetaRate;
 
                 sigmaXSum += sigmaXrate;
                 tauXSum   += tauXrate;
@@ -1206,15 +1422,20 @@ public:
                 const REAL timDiff = times[locationCount-1]-times[i];
                 const REAL expOmegaTimDiff = exp(-omega*timDiff);
 
+                const REAL cdfDiff = cdf(tauTprec*timDiff) - cdf(tauTprec*(-times[i]));
+
                 gradContribs[i].s0 = sigmaXScratch[0] / totalRateScratch[0];
                 gradContribs[i].s1 = tauXScratch[0]   / totalRateScratch[0];
                 gradContribs[i].s2 = tauTScratch[0]   / totalRateScratch[0] * tauXprecD +
                                      pdf(tauTprec * timDiff) * timDiff + pdf(tauTprec*times[i])*times[i];
-                gradContribs[i].s3 = (1-(1+omega*timDiff) * expOmegaTimDiff)/(omega*omega) -
-                                     omegaScratch[0]/totalRateScratch[0] * sigmaXprecD;
-                gradContribs[i].s4 = thetaScratch[0] / totalRateScratch[0] * sigmaXprecD + (expOmegaTimDiff-1)/omega;
-                gradContribs[i].s5 = mu0Scratch[0] / totalRateScratch[0] * tauXprecD * tauTprec -
-                                     ( cdf(tauTprec*timDiff) - cdf(tauTprec*(-times[i])) );
+                gradContribs[i].s3 = (thetaScratch[0] - omega * omegaScratch[0]) / totalRateScratch[0] * sigmaXprecD -
+                                     timDiff * expOmegaTimDiff;
+                gradContribs[i].s4 = thetaScratch[0] / totalRateScratch[0] * sigmaXprecD * omega + (expOmegaTimDiff-1);
+                gradContribs[i].s5 = mu0Scratch[0] / totalRateScratch[0] * tauXprecD * tauTprec - cdfDiff;
+                gradContribs[i].s6 = log(totalRateScratch[0]) + theta * (expOmegaTimDiff-1) - mu0 * cdfDiff;
+                gradContribs[i].s7 = ZERO;
+
+                probsSelfExcite[i] = sigmaXprecDThetaOmega * thetaScratch[0] / totalRateScratch[0];
 
                 );
 
@@ -1244,12 +1465,149 @@ public:
     }
 
 
+    void createOpenCLIntensityKernel() {
+
+        const char pdfString1Double[] = BOOST_COMPUTE_STRINGIZE_SOURCE(
+                static double pdf(double);
+
+                static double pdf(double value) {
+                    return 0.5 * M_SQRT1_2 * M_2_SQRTPI * exp( - pow(value,2.0) * 0.5);
+                }
+        );
+
+        const char pdfString1Float[] = BOOST_COMPUTE_STRINGIZE_SOURCE(
+                static float pdf(float);
+
+                static float pdf(float value) {
+
+                    const float rSqrt2f = 0.70710678118655f;
+                    const float rSqrtPif = 0.56418958354775f;
+                    return rSqrt2f * rSqrtPif * exp( - pow(value,2.0f) * 0.5f);
+                }
+        );
+
+        std::stringstream code;
+        std::stringstream options;
+
+        options << "-DTILE_DIM=" << TILE_DIM << " -DTPB=" << TPB;
+
+        if (sizeof(RealType) == 8) { // 64-bit fp
+            code << " #pragma OPENCL EXTENSION cl_khr_fp64 : enable\n";
+            options << " -DREAL=double -DREAL_VECTOR=double" << OpenCLRealType::dim << " -DCAST=long"
+                    << " -DZERO=0.0 -DHALF=0.5 -DONE=1.0";
+            code << pdfString1Double;
+
+        } else { // 32-bit fp
+            options << " -DREAL=float -DREAL_VECTOR=float" << OpenCLRealType::dim << " -DCAST=int"
+                    << " -DZERO=0.0f -DHALF=0.5f -DONE=1.0f";
+            code << pdfString1Float;
+        }
+
+        code <<
+             " __kernel void computeIntensity(__global const REAL_VECTOR *locations,    \n" <<
+             "                                __global const REAL *times,               \n" <<
+             "                                __global const REAL_VECTOR *queries,      \n" <<
+             "                                __global const REAL *queryTimes,          \n" <<
+             "                                __global REAL *background,                \n" <<
+             "                                __global REAL *selfExcite,                \n" <<
+             "                                const REAL sigmaXprec,                    \n" <<
+             "                                const REAL tauXprec,                      \n" <<
+             "                                const REAL tauTprec,                      \n" <<
+             "                                const REAL omega,                         \n" <<
+             "                                const REAL theta,                         \n" <<
+             "                                const REAL mu0,                           \n" <<
+             "                                const int dimX,                           \n" <<
+             "                                const uint locationCount) {               \n";
+
+        code <<
+             "   const uint q = get_group_id(0);                                     \n" <<
+             "                                                                       \n" <<
+             "   const uint lid = get_local_id(0);                                   \n" <<
+             "   uint j = get_local_id(0);                                           \n" <<
+             "                                                                       \n" <<
+             "   __local REAL scratch1[TPB];                                         \n" <<
+             "   __local REAL scratch2[TPB];                                         \n" <<
+             "   const REAL_VECTOR vectorQ = queries[q];                             \n" <<
+             "   const REAL timeQ = queryTimes[q];                                   \n" <<
+             "                                                                       \n" <<
+             "   REAL        sum1 = ZERO;                                            \n" <<
+             "   REAL        sum2 = ZERO;                                            \n" <<
+             "   REAL mu0TauXprecDTauTprec = mu0 * pow(tauXprec,dimX) * tauTprec;    \n" <<
+             "   REAL thetaSigmaXprecDOmega = theta * pow(sigmaXprec,dimX) * omega;  \n" <<
+             "                                                                       \n" <<
+             "   while (j < locationCount) {                                         \n" <<
+             "                                                                       \n" <<
+             "     const REAL timDiff = timeQ - times[j];                            \n" <<
+             "     const REAL_VECTOR vectorJ = locations[j];                         \n" <<
+             "     const REAL_VECTOR difference = vectorQ - vectorJ;                 \n";
+
+        if (OpenCLRealType::dim == 8) {
+            code << "     const REAL distance = sqrt(                                \n" <<
+                 "              dot(difference.lo, difference.lo) +               \n" <<
+                 "              dot(difference.hi, difference.hi)                 \n" <<
+                 "      );                                                        \n";
+
+        } else {
+            code << "     const REAL distance = length(difference);                  \n";
+        }
+
+        code << BOOST_COMPUTE_STRINGIZE_SOURCE(
+                sum1 += pdf(distance * tauXprec) * pdf(timDiff*tauTprec);
+                sum2 += select(ZERO, exp(-omega * timDiff), (CAST)isgreater(timDiff,ZERO)) * pdf(distance * sigmaXprec);
+        );
+
+        code <<
+             "     j += TPB;                                                         \n" <<
+             "     }                                                                 \n" <<
+             "     scratch1[lid] = sum1;                                             \n" <<
+             "     scratch2[lid] = sum2;                                             \n";
+
+        code <<
+             "     for(int k = 1; k < TPB; k <<= 1) {                                 \n" <<
+             "       barrier(CLK_LOCAL_MEM_FENCE);                                    \n" <<
+             "       uint mask = (k << 1) - 1;                                        \n" <<
+             "       if ((lid & mask) == 0) {                                         \n" <<
+             "           scratch1[lid] += scratch1[lid + k];                          \n" <<
+             "           scratch2[lid] += scratch2[lid + k];                          \n" <<
+             "       }                                                                \n" <<
+             "   }                                                                    \n";
+
+        code <<
+             "   barrier(CLK_LOCAL_MEM_FENCE);                                       \n" <<
+             "   if (lid == 0) {                                                     \n" <<
+             "     background[q] = mu0TauXprecDTauTprec * scratch1[0];               \n" <<
+             "     selfExcite[q] = thetaSigmaXprecDOmega * scratch2[0];              \n" <<
+             "   }                                                                   \n" <<
+             " }                                                                     \n ";
+
+#ifdef DEBUG_KERNELS
+#ifdef RBUILD
+        Rcpp::Rcout << "Intensity kernel\n" << code.str() << std::endl;
+#else
+        std::cerr << "Intensity kernel\n" << options.str() << code.str() << std::endl;
+#endif
+#endif
+
+        program = boost::compute::program::build_with_source(code.str(), ctx, options.str());
+        kernelIntensity = boost::compute::kernel(program, "computeIntensity");
+
+#ifdef DEBUG_KERNELS
+#ifdef RBUILD
+        Rcpp::Rcout << "Successful build." << std::endl;
+#else
+        std::cerr << "Successful build." << std::endl;
+#endif
+#endif
+
+    }
+
 	void createOpenCLKernels() {
 
         createOpenCLLikContribsKernel();
 		createOpenCLGradientKernel();
 		createOpenCLSummationKernel();
         createOpenCLProbsSelfExciteKernel();
+        createOpenCLIntensityKernel();
 
 	}
 
@@ -1270,6 +1628,14 @@ private:
     double sumOfLikContribs;
     double storedSumOfLikContribs;
 
+    double truncationTolerance;
+
+    std::vector<double> fusedSums;
+    StateVersion likelihoodVersion;
+    StateVersion gradientVersion;
+    StateVersion probsVersion;
+    bool storedLikelihoodKnown;
+
     boost::compute::device device;
     boost::compute::context ctx;
     boost::compute::command_queue queue;
@@ -1333,6 +1699,7 @@ private:
 	boost::compute::kernel kernelGradientVector;
     boost::compute::kernel kernelLikSum;
     boost::compute::kernel kernelProbsSelfExcite;
+    boost::compute::kernel kernelIntensity;
 
 #else
     boost::compute::kernel kernelLikContribs;
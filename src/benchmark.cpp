@@ -8,6 +8,11 @@
 #include <tbb/task_scheduler_init.h>
 
 #include "AbstractHawkes.hpp"
+#include "Sampler.hpp"
+#include "MultiChain.hpp"
+#include "Optimizer.hpp"
+#include "Simulator.hpp"
+#include "EventFile.hpp"
 
 
 //int cnt = 0;
@@ -33,6 +38,7 @@ int main(int argc, char* argv[]) {
             ("gpu", po::value<int>()->default_value(0), "number of GPU on which to run")
             ("tbb", po::value<int>()->default_value(0), "use TBB with specified number of threads")
             ("float", "run in single-precision")
+            ("mixed", "run single-precision kernels with compensated double accumulation")
             ("iterations", po::value<int>()->default_value(1), "number of iterations")
             ("locations", po::value<int>()->default_value(3), "number of locations")
             ("dimension", po::value<int>()->default_value(2), "number of dimensions")
@@ -40,6 +46,28 @@ int main(int argc, char* argv[]) {
             ("sse", "use hand-rolled SSE")
             ("avx", "use hand-rolled AVX")
             ("avx512", "use hand-rolled AVX-512")
+            ("auto-simd", "use the widest SIMD the CPU supports")
+            ("truncation", po::value<double>()->default_value(0.0), "relative time-window truncation tolerance")
+            ("spatial", "prune pairs with a spatial grid / k-d tree")
+            ("neighbours", "reuse a neighbour-pair list across iterations")
+            ("cache", po::value<std::string>(), "cache pairwise distances in half, float or double")
+            ("symmetric", "evaluate each unordered pair once")
+            ("deterministic", "make reductions bitwise identical for any thread count")
+            ("fused", "evaluate likelihood, gradient and probabilities in one pass")
+            ("sample", po::value<int>()->default_value(0), "run the adaptive M-H (or NUTS) sampler for this many iterations")
+            ("nuts", "sample with NUTS instead of M-H")
+            ("chains", po::value<int>()->default_value(1), "number of chains sharing the engine's data and threads")
+            ("simulate", "simulate self-exciting data from the branching process instead of iid times and locations")
+            ("events", po::value<std::string>(), "load times and locations from a binary event file (overrides --locations and --dimension)")
+            ("write-events", po::value<std::string>(), "write the generated times and locations to a binary event file")
+            ("load-state", po::value<std::string>(), "resume from an engine snapshot with the same number of events")
+            ("save-state", po::value<std::string>(), "write an engine snapshot at the end of the run")
+            ("append", po::value<int>()->default_value(0), "stream this many further events in one at a time")
+            ("window", po::value<double>()->default_value(0.0), "keep only events within this time of the latest while streaming")
+            ("map", "find the MAP parameters with L-BFGS (and start any sampler there)")
+            ("temperatures", po::value<int>()->default_value(1), "number of parallel-tempering chains (inverse temperatures 2^-k)")
+            ("intensity", po::value<int>()->default_value(0), "evaluate the conditional intensity at this many random query points")
+            ("compensator", po::value<int>()->default_value(0), "evaluate expected counts in this many random space-time boxes")
 	;
 	po::variables_map vm;
 
@@ -65,6 +93,13 @@ int main(int argc, char* argv[]) {
 
 	int embeddingDimension = vm["dimension"].as<int>();
 	int locationCount = vm["locations"].as<int>();
+
+	std::unique_ptr<hph::MappedEventFile> eventFile;
+	if (vm.count("events")) {
+		eventFile.reset(new hph::MappedEventFile(vm["events"].as<std::string>()));
+		embeddingDimension = eventFile->getEmbeddingDimension();
+		locationCount = eventFile->getEventCount();
+	}
     int iterations = vm["iterations"].as<int>();
 
     long flags = 0L;
@@ -95,9 +130,42 @@ int main(int argc, char* argv[]) {
 			flags |= hph::Flags::TBB;
 			task = std::make_shared<tbb::task_scheduler_init>(threads);
 		}
+
+		if (vm.count("spatial")) {
+			std::cout << "Using spatial index" << std::endl;
+			flags |= hph::Flags::SPATIAL_INDEX;
+		}
+
+		if (vm.count("neighbours")) {
+			std::cout << "Using neighbour list" << std::endl;
+			flags |= hph::Flags::NEIGHBOUR_LIST;
+		}
+
+		if (vm.count("symmetric")) {
+			std::cout << "Using symmetric pairs" << std::endl;
+			flags |= hph::Flags::SYMMETRIC;
+		}
+
+		if (vm.count("deterministic")) {
+			std::cout << "Using deterministic reductions" << std::endl;
+			flags |= hph::Flags::DETERMINISTIC;
+		}
+
+		if (vm.count("cache")) {
+			const auto storage = vm["cache"].as<std::string>();
+			flags |= hph::Flags::DISTANCE_CACHE;
+			if (storage == "half") {
+				flags |= hph::Flags::DISTANCE_CACHE_HALF;
+			} else if (storage == "double") {
+				flags |= hph::Flags::DISTANCE_CACHE_DOUBLE;
+			}
+		}
 	}
 	
-	if (vm.count("float")) {
+	if (vm.count("mixed")) {
+		std::cout << "Running in mixed-precision" << std::endl;
+		flags |= hph::Flags::MIXED;
+	} else if (vm.count("float")) {
 		std::cout << "Running in single-precision" << std::endl;
 		flags |= hph::Flags::FLOAT;
 	} else {
@@ -118,9 +186,13 @@ int main(int argc, char* argv[]) {
         ++simdCount;
         simd = "avx512";
     }
+    if (vm.count("auto-simd")){
+        ++simdCount;
+        simd = "auto";
+    }
 
     if (simdCount > 0) {
-#if not defined(USE_SSE) && not defined(USE_AVX) && not defined(USE_AVX512)
+#if not defined(HAVE_SSE) && not defined(HAVE_AVX) && not defined(HAVE_AVX512)
         std::cerr << "SIMD is not implemented" << std::endl;
         exit(-1);
 #else
@@ -128,46 +200,98 @@ int main(int argc, char* argv[]) {
             std::cerr << "Can not request more than one SIMD simultaneously" << std::endl;
             exit(-1);
         }
-        if (vm.count("avx512")) {
-#ifndef USE_AVX512
+        if (vm.count("auto-simd")) {
+            flags |= hph::Flags::AUTO;
+        } else if (vm.count("avx512")) {
+#ifndef HAVE_AVX512
             std::cerr << "AVX-512 is not implemented" << std::endl;
             exit(-1);
 #else
             flags |= hph::Flags::AVX512;
-#endif // USE_AVX512
+#endif // HAVE_AVX512
 
 		} else if (vm.count("avx")) {
-#ifndef USE_AVX
+#ifndef HAVE_AVX
 			std::cerr << "AVX is not implemented" << std::endl;
 			exit(-1);
 #else
             flags |= hph::Flags::AVX;
-#endif // USE_AVX
+#endif // HAVE_AVX
         } else {
             flags |= hph::Flags::SSE;
         }
-#endif // not defined(USE_SSE) && not defined(USE_AVX) && not defined(USE_AVX512)
+#endif // not defined(HAVE_SSE) && not defined(HAVE_AVX) && not defined(HAVE_AVX512)
 	}
 
 	bool internalDimension = vm.count("internal");
 
 	hph::SharedPtr instance = hph::factory(embeddingDimension, locationCount, flags, deviceNumber, threads);
 
-    auto elementCount = locationCount * locationCount; // size of pairwise data
-
-    std::vector<double> times(locationCount);
-	times[0] = expo(prng);
-	for (int i = 1; i < locationCount; ++i) {
-	    times[i] = times[i-1] + expo(prng);
+	if (flags & hph::Flags::DISTANCE_CACHE) {
+		std::cout << "Distance cache uses " << instance->getDistanceCacheFootprint() << " bytes" << std::endl;
 	}
-    instance->setTimesData(&times[0], locationCount);
+
+    auto elementCount = locationCount * locationCount; // size of pairwise data
 
     int dataDimension = internalDimension ? instance->getInternalDimension() : embeddingDimension;
 
+    std::vector<double> times(locationCount);
     std::vector<double> location(dataDimension);
-    for (int i = 0; i < locationCount; ++i) {
-        generateLocation(location, normal, prng);
-        instance->updateLocations(i, &location[0], dataDimension);
+    std::vector<double> locations;
+
+    if (eventFile) {
+        auto startLoad = std::chrono::steady_clock::now();
+
+        const double* fileTimes = eventFile->getTimes();
+        const double* fileLocations = eventFile->getLocations();
+        std::copy(fileTimes, fileTimes + locationCount, times.begin());
+
+        if (dataDimension == embeddingDimension) {
+            eventFile->load(*instance);
+        } else {
+            instance->setTimesData(&times[0], locationCount);
+            for (int i = 0; i < locationCount; ++i) {
+                std::copy(&fileLocations[i * embeddingDimension], &fileLocations[(i + 1) * embeddingDimension], location.begin());
+                instance->updateLocations(i, &location[0], dataDimension);
+            }
+        }
+
+        auto durationLoad = std::chrono::steady_clock::now() - startLoad;
+        std::cout << "Loaded " << locationCount << " events from " << vm["events"].as<std::string>() << " in "
+                  << std::chrono::duration<double, std::milli>(durationLoad).count() << " ms" << std::endl;
+    } else if (vm.count("simulate")) {
+        auto startSimulation = std::chrono::steady_clock::now();
+
+        const double simulationParameters[] = {2.0, 0.5, 0.2, 1.0, 0.5, 1.0};
+        hph::HawkesSimulator simulator(embeddingDimension, simulationParameters, 666, 10.0, threads);
+        simulator.simulate(locationCount, times, locations);
+
+        auto durationSimulation = std::chrono::steady_clock::now() - startSimulation;
+        std::cout << "Simulated " << locationCount << " events in "
+                  << std::chrono::duration<double, std::milli>(durationSimulation).count() << " ms" << std::endl;
+
+        instance->setTimesData(&times[0], locationCount);
+        for (int i = 0; i < locationCount; ++i) {
+            std::copy(&locations[i * embeddingDimension], &locations[(i + 1) * embeddingDimension], location.begin());
+            instance->updateLocations(i, &location[0], dataDimension);
+        }
+    } else {
+        times[0] = expo(prng);
+        for (int i = 1; i < locationCount; ++i) {
+            times[i] = times[i-1] + expo(prng);
+        }
+        instance->setTimesData(&times[0], locationCount);
+
+        for (int i = 0; i < locationCount; ++i) {
+            generateLocation(location, normal, prng);
+            instance->updateLocations(i, &location[0], dataDimension);
+            locations.insert(locations.end(), location.begin(), location.begin() + embeddingDimension);
+        }
+    }
+
+    if (vm.count("write-events") && !eventFile) {
+        hph::writeEventFile(vm["write-events"].as<std::string>(), &times[0], &locations[0], locationCount,
+                            embeddingDimension);
     }
 
 	std::vector<double> parameters(6);
@@ -176,8 +300,30 @@ int main(int argc, char* argv[]) {
     }
 	instance->setParameters(&parameters[0], 6);
 
+	double truncation = vm["truncation"].as<double>();
+	instance->setTruncation(truncation);
+
+	if (vm.count("load-state")) {
+		auto startLoad = std::chrono::steady_clock::now();
+
+		instance->loadState(vm["load-state"].as<std::string>());
+		if (instance->getLocationCount() != locationCount) {
+			std::cerr << "Engine snapshot holds " << instance->getLocationCount() << " events, not "
+			          << locationCount << std::endl;
+			exit(-1);
+		}
+		const double restored = instance->getSumOfLikContribs();
+
+		auto durationLoad = std::chrono::steady_clock::now() - startLoad;
+		std::cout << "Restored engine state with log-likelihood " << restored << " in "
+		          << std::chrono::duration<double, std::milli>(durationLoad).count() << " ms" << std::endl;
+	}
+
 	auto logLik = 0; //instance->getSumOfLikContribs();
 
+	bool fused = vm.count("fused");
+	std::vector<double> gradient(6);
+
     std::vector<double> probSEs(locationCount,0.0);
 	//instance->getLogLikelihoodGradient(gradient.data(),6);
     auto sumProbSEs = probSEs;
@@ -198,20 +344,26 @@ int main(int argc, char* argv[]) {
 
 		auto startTime1 = std::chrono::steady_clock::now();
 
-		auto inc = instance->getSumOfLikContribs();
+		double inc;
+		if (fused) {
+			instance->evaluateAll(&inc, gradient.data(), probSEs.data());
+		} else {
+			inc = instance->getSumOfLikContribs();
+		}
 
         logLik += inc;
 		
 		auto duration1 = std::chrono::steady_clock::now() - startTime1;
 		timer += std::chrono::duration<double, std::milli>(duration1).count();
 
+        if (!fused) {
+            auto startTime2 = std::chrono::steady_clock::now();
 
-        auto startTime2 = std::chrono::steady_clock::now();
-
-        instance->getProbsSelfExcite(probSEs.data(),locationCount);
+            instance->getProbsSelfExcite(probSEs.data(),locationCount);
 
-        auto duration2 = std::chrono::steady_clock::now() - startTime2;
-        timer2 += std::chrono::duration<double, std::milli>(duration2).count();
+            auto duration2 = std::chrono::steady_clock::now() - startTime2;
+            timer2 += std::chrono::duration<double, std::milli>(duration2).count();
+        }
 
         std::transform(sumProbSEs.begin(),sumProbSEs.end(),
                 probSEs.begin(),sumProbSEs.begin(),std::plus<double>());
@@ -224,6 +376,9 @@ int main(int argc, char* argv[]) {
 
 	std::cout << "End HPH benchmark" << std::endl;
 	std::cout << "AvgLogLik = " << logLik << std::endl;
+	if (truncation > 0.0) {
+		std::cout << "TruncationErrorBound = " << instance->getTruncationErrorBound() << std::endl;
+	}
     std::cout << "AvgProbSE = " << std::accumulate(sumProbSEs.begin(), sumProbSEs.end(), 0.0) / iterations / locationCount << std::endl;
 //    std::cout << "AvgGradient = " << "(" << sumGradient[0] << ", " << sumGradient[1] << ", " <<  sumGradient[2] << ", " <<
 //    sumGradient[3] << ", " <<  sumGradient[4] << ", " <<  sumGradient[5] << ")" <<  std::endl;
@@ -233,6 +388,142 @@ int main(int argc, char* argv[]) {
 	std::cout << std::chrono::duration<double, std::milli> (duration).count() << " ms "
 			  << std::endl;
 
+	int appendCount = vm["append"].as<int>();
+	if (appendCount > 0) {
+		instance->getSumOfLikContribs(); // Streamed updates start from known rates
+		instance->setWindow(vm["window"].as<double>());
+
+		auto startAppend = std::chrono::steady_clock::now();
+
+		double time = times.back();
+		std::vector<double> newLocation(embeddingDimension);
+		double streamedLogLik = 0.0;
+		for (int i = 0; i < appendCount; ++i) {
+			time += expo(prng);
+			generateLocation(newLocation, normal, prng);
+			instance->appendEvents(&time, &newLocation[0], 1);
+			streamedLogLik = instance->getSumOfLikContribs();
+		}
+
+		auto durationAppend = std::chrono::steady_clock::now() - startAppend;
+		std::cout << "Streamed " << appendCount << " events, final loglik = " << streamedLogLik
+		          << " over " << instance->getLocationCount() << " events" << std::endl;
+		std::cout << std::chrono::duration<double, std::milli>(durationAppend).count() << " ms" << std::endl;
+	}
+
+	int queryCount = vm["intensity"].as<int>();
+	if (queryCount > 0) {
+		std::vector<double> queryLocations(queryCount * embeddingDimension);
+		std::vector<double> queryTimes(queryCount);
+		std::vector<double> intensity(queryCount);
+		std::uniform_real_distribution<double> uniform(0.0, times.back());
+		for (int q = 0; q < queryCount; ++q) {
+			queryTimes[q] = uniform(prng);
+			generateLocation(location, normal, prng);
+			std::copy(location.begin(), location.begin() + embeddingDimension,
+			          queryLocations.begin() + q * embeddingDimension);
+		}
+
+		auto startIntensity = std::chrono::steady_clock::now();
+
+		instance->evaluateIntensity(&queryLocations[0], &queryTimes[0], queryCount, &intensity[0],
+		                            nullptr, nullptr);
+
+		auto durationIntensity = std::chrono::steady_clock::now() - startIntensity;
+		std::cout << "Evaluated intensity at " << queryCount << " points, mean = "
+		          << std::accumulate(intensity.begin(), intensity.end(), 0.0) / queryCount << std::endl;
+		std::cout << std::chrono::duration<double, std::milli>(durationIntensity).count() << " ms" << std::endl;
+	}
+
+	int boxCount = vm["compensator"].as<int>();
+	if (boxCount > 0) {
+		std::vector<double> lower(boxCount * embeddingDimension);
+		std::vector<double> upper(boxCount * embeddingDimension);
+		std::vector<double> startTimes(boxCount);
+		std::vector<double> endTimes(boxCount);
+		std::vector<double> expected(boxCount);
+		std::uniform_real_distribution<double> uniform(0.0, times.back());
+		for (int q = 0; q < boxCount; ++q) {
+			startTimes[q] = uniform(prng);
+			endTimes[q] = startTimes[q] + expo(prng);
+			generateLocation(location, normal, prng);
+			for (int d = 0; d < embeddingDimension; ++d) {
+				lower[q * embeddingDimension + d] = location[d];
+				upper[q * embeddingDimension + d] = location[d] + 1.0;
+			}
+		}
+
+		auto startCompensator = std::chrono::steady_clock::now();
+
+		instance->evaluateCompensator(&lower[0], &upper[0], &startTimes[0], &endTimes[0], boxCount,
+		                              &expected[0], nullptr, nullptr);
+
+		auto durationCompensator = std::chrono::steady_clock::now() - startCompensator;
+		std::cout << "Evaluated expected counts in " << boxCount << " boxes, mean = "
+		          << std::accumulate(expected.begin(), expected.end(), 0.0) / boxCount << std::endl;
+		std::cout << std::chrono::duration<double, std::milli>(durationCompensator).count() << " ms" << std::endl;
+	}
+
+	if (vm.count("map")) {
+		auto startMap = std::chrono::steady_clock::now();
+
+		hph::LbfgsOptimizer optimizer(*instance, {0, 3, 4, 5},
+				std::vector<double>(6, 1e-6), std::vector<double>(6, INFINITY));
+		std::vector<double> optimum(6);
+		const double logPosterior = optimizer.run(parameters.data(), optimum.data());
+		parameters = optimum;
+
+		auto durationMap = std::chrono::steady_clock::now() - startMap;
+		std::cout << "MAP log posterior = " << logPosterior << " after " << optimizer.getIterationCount()
+		          << " iterations, " << optimizer.getEvaluationCount() << " evaluations ("
+		          << (optimizer.hasConverged() ? "converged" : "not converged") << ")" << std::endl;
+		std::cout << std::chrono::duration<double, std::milli>(durationMap).count() << " ms" << std::endl;
+	}
+
+	int sampleCount = vm["sample"].as<int>();
+	if (sampleCount > 0) {
+		const int chains = vm["chains"].as<int>();
+		hph::MultiChainDriver driver(*instance, chains, std::max(threads / chains, 1));
+
+		auto startSample = std::chrono::steady_clock::now();
+
+		driver.run([&](const int chain, hph::AbstractHawkes& engine) {
+			std::vector<double> samples(6 * sampleCount);
+			if (vm.count("nuts")) {
+				hph::NutsSampler sampler(engine, {0, 3, 4, 5}, 666 + chain);
+				sampler.run(parameters.data(), sampleCount, sampleCount / 2, samples.data(), nullptr);
+				if (chain == 0) {
+					std::cout << "NUTS step size = " << sampler.getStepSize() << ", evaluations = "
+					          << sampler.getEvaluationCount() << std::endl;
+				}
+			} else if (vm["temperatures"].as<int>() > 1) {
+				std::vector<double> inverseTemperatures(vm["temperatures"].as<int>());
+				for (int k = 0; k < static_cast<int>(inverseTemperatures.size()); ++k) {
+					inverseTemperatures[k] = std::pow(0.5, k);
+				}
+				hph::TemperingSampler sampler(engine, inverseTemperatures, 2.0, 666 + chain);
+				sampler.run(parameters.data(), sampleCount, 0, samples.data(), nullptr);
+				if (chain == 0) {
+					std::cout << "Tempering acceptance rate = " << sampler.getAcceptanceRate(0)
+					          << ", swap rate = " << sampler.getSwapAcceptanceRate() << std::endl;
+				}
+			} else {
+				hph::AdaptiveSampler sampler(engine, 2.0, 666 + chain);
+				sampler.run(parameters.data(), sampleCount, 0, samples.data(), nullptr);
+				if (chain == 0) {
+					std::cout << "Sampler acceptance rate = " << sampler.getAcceptanceRate() << std::endl;
+				}
+			}
+		});
+
+		auto durationSample = std::chrono::steady_clock::now() - startSample;
+		std::cout << std::chrono::duration<double, std::milli>(durationSample).count() << " ms" << std::endl;
+	}
+
+	if (vm.count("save-state")) {
+		instance->saveState(vm["save-state"].as<std::string>());
+	}
+
 	std::ofstream outfile;
 	outfile.open("report.txt",std::ios_base::app);
     outfile << deviceNumber << " " << threads << " " << simd << " " << locationCount << " " << embeddingDimension << " " << iterations << " " << timer << " " << timer2 << "\n" ;
@@ -12,30 +12,114 @@ namespace hph {
     SharedPtr constructNewHawkesFloatNoParallelNoSimd(int, int, long, int);
     SharedPtr constructNewHawkesFloatTbbNoSimd(int, int, long, int);
 
-#ifdef USE_SSE
+    SharedPtr constructNewHawkesMixedNoParallelNoSimd(int, int, long, int);
+    SharedPtr constructNewHawkesMixedTbbNoSimd(int, int, long, int);
+
+#ifdef HAVE_SSE
     SharedPtr constructNewHawkesDoubleTbbSse(int, int, long, int);
     SharedPtr constructNewHawkesDoubleNoParallelSse(int, int, long, int);
     SharedPtr constructNewHawkesFloatNoParallelSse(int, int, long, int);
     SharedPtr constructNewHawkesFloatTbbSse(int, int, long, int);
+    SharedPtr constructNewHawkesMixedNoParallelSse(int, int, long, int);
+    SharedPtr constructNewHawkesMixedTbbSse(int, int, long, int);
 #endif
 
-#ifdef USE_AVX
+#ifdef HAVE_AVX
     SharedPtr constructNewHawkesDoubleTbbAvx(int, int, long, int);
     SharedPtr constructNewHawkesDoubleNoParallelAvx(int, int, long, int);
+    SharedPtr constructNewHawkesFloatNoParallelAvx(int, int, long, int);
+    SharedPtr constructNewHawkesFloatTbbAvx(int, int, long, int);
+    SharedPtr constructNewHawkesMixedNoParallelAvx(int, int, long, int);
+    SharedPtr constructNewHawkesMixedTbbAvx(int, int, long, int);
 #endif
 
-#ifdef USE_AVX512
+#ifdef HAVE_AVX512
     SharedPtr constructNewHawkesDoubleTbbAvx512(int, int, long, int);
     SharedPtr constructNewHawkesDoubleNoParallelAvx512(int, int, long, int);
+    SharedPtr constructNewHawkesFloatNoParallelAvx512(int, int, long, int);
+    SharedPtr constructNewHawkesFloatTbbAvx512(int, int, long, int);
+    SharedPtr constructNewHawkesMixedNoParallelAvx512(int, int, long, int);
+    SharedPtr constructNewHawkesMixedTbbAvx512(int, int, long, int);
+#endif
+
+namespace {
+
+    // SIMD flag for the widest engine that was built and that the running CPU supports
+    long getSupportedSimd() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_cpu_init();
+#ifdef HAVE_AVX512
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd") &&
+            __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq") &&
+            __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx2") &&
+            __builtin_cpu_supports("fma")) {
+            return hph::Flags::AVX512;
+        }
+#endif
+#ifdef HAVE_AVX
+        if (__builtin_cpu_supports("avx") && __builtin_cpu_supports("fma")) {
+            return hph::Flags::AVX;
+        }
+#endif
+#ifdef HAVE_SSE
+        if (__builtin_cpu_supports("sse4.2")) {
+            return hph::Flags::SSE;
+        }
+#endif
 #endif
+        return 0L;
+    }
+
+} // namespace
 
 SharedPtr factory(int dim1, int dim2, long flags, int device, int threads) {
+	if (flags & hph::Flags::AUTO) {
+	    flags &= ~(hph::Flags::SSE | hph::Flags::AVX | hph::Flags::AVX512);
+	    flags |= getSupportedSimd();
+	}
+
 	bool useFloat = flags & hph::Flags::FLOAT;
 	bool useOpenCL = flags & hph::Flags::OPENCL;
 	bool useTbb = flags & hph::Flags::TBB;
     bool useAvx512 = flags & hph::Flags::AVX512;
 	bool useAvx = flags & hph::Flags::AVX;
 	bool useSse = flags & hph::Flags::SSE;
+	bool useMixed = flags & hph::Flags::MIXED;
+
+	if (useMixed && !useOpenCL) {
+#ifdef HAVE_AVX512
+	    if (useAvx512) {
+            if (useTbb) {
+                return constructNewHawkesMixedTbbAvx512(dim1, dim2, flags, threads);
+            } else {
+                return constructNewHawkesMixedNoParallelAvx512(dim1, dim2, flags, threads);
+            }
+	    }
+#endif
+#ifdef HAVE_AVX
+	    if (useAvx) {
+            if (useTbb) {
+                return constructNewHawkesMixedTbbAvx(dim1, dim2, flags, threads);
+            } else {
+                return constructNewHawkesMixedNoParallelAvx(dim1, dim2, flags, threads);
+            }
+	    }
+#endif
+#ifdef HAVE_SSE
+	    if (useSse) {
+            if (useTbb) {
+                return constructNewHawkesMixedTbbSse(dim1, dim2, flags, threads);
+            } else {
+                return constructNewHawkesMixedNoParallelSse(dim1, dim2, flags, threads);
+            }
+	    }
+#endif
+        if (useTbb) {
+            return constructNewHawkesMixedTbbNoSimd(dim1, dim2, flags, threads);
+        } else {
+            return constructNewHawkesMixedNoParallelNoSimd(dim1, dim2, flags, threads);
+        }
+	}
 
 	if (useFloat) {
 		if (useOpenCL) {
@@ -45,7 +129,25 @@ SharedPtr factory(int dim1, int dim2, long flags, int device, int threads) {
 		  return constructNewHawkesFloatNoParallelNoSimd(dim1, dim2, flags, threads);
 #endif
 		} else {
-#ifdef USE_SSE
+#ifdef HAVE_AVX512
+		    if (useAvx512) {
+                if (useTbb) {
+                    return constructNewHawkesFloatTbbAvx512(dim1, dim2, flags, threads);
+                } else {
+                    return constructNewHawkesFloatNoParallelAvx512(dim1, dim2, flags, threads);
+                }
+		    }
+#endif // HAVE_AVX512
+#ifdef HAVE_AVX
+		    if (useAvx) {
+                if (useTbb) {
+                    return constructNewHawkesFloatTbbAvx(dim1, dim2, flags, threads);
+                } else {
+                    return constructNewHawkesFloatNoParallelAvx(dim1, dim2, flags, threads);
+                }
+		    }
+#endif // HAVE_AVX
+#ifdef HAVE_SSE
 		    if (useSse) {
                 if (useTbb) {
                     return constructNewHawkesFloatTbbSse(dim1, dim2, flags, threads);
@@ -59,7 +161,7 @@ SharedPtr factory(int dim1, int dim2, long flags, int device, int threads) {
                 } else {
                     return constructNewHawkesFloatNoParallelNoSimd(dim1, dim2, flags, threads);
                 }
-#ifdef USE_SSE
+#ifdef HAVE_SSE
             }
 #endif
 		}
@@ -72,7 +174,7 @@ SharedPtr factory(int dim1, int dim2, long flags, int device, int threads) {
 #endif
 		} else {
 
-#ifdef USE_AVX512
+#ifdef HAVE_AVX512
             if (useAvx512) {
                 if (useTbb) {
                     return constructNewHawkesDoubleTbbAvx512(dim1, dim2, flags, threads);
@@ -82,9 +184,9 @@ SharedPtr factory(int dim1, int dim2, long flags, int device, int threads) {
             } else
 #else
               useAvx512 = false; // stops unused variable warning when AVX512 is unavailable
-#endif // USE_AVX512
+#endif // HAVE_AVX512
 
-#ifdef USE_AVX
+#ifdef HAVE_AVX
 		    if (useAvx) {
                 if (useTbb) {
                     return constructNewHawkesDoubleTbbAvx(dim1, dim2, flags, threads);
@@ -94,9 +196,9 @@ SharedPtr factory(int dim1, int dim2, long flags, int device, int threads) {
             } else
 #else
               useAvx = false;
-#endif // USE_AVX
+#endif // HAVE_AVX
 
-#ifdef USE_SSE
+#ifdef HAVE_SSE
 		    if (useSse) {
                 if (useTbb) {
                     return constructNewHawkesDoubleTbbSse(dim1, dim2, flags, threads);
@@ -104,7 +206,7 @@ SharedPtr factory(int dim1, int dim2, long flags, int device, int threads) {
                     return constructNewHawkesDoubleNoParallelSse(dim1, dim2, flags, threads);
                 }
 		    } else
-#endif // USE_SSE
+#endif // HAVE_SSE
             {
 
                 if (useTbb) {
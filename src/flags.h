@@ -9,7 +9,16 @@ enum Flags {
 	OPENCL = 1 << 4,
     SSE = 1 << 5,
     AVX = 1 << 6,
-	AVX512 = 1 << 7
+	AVX512 = 1 << 7,
+	SPATIAL_INDEX = 1 << 8,
+	NEIGHBOUR_LIST = 1 << 9,
+	DISTANCE_CACHE = 1 << 10,
+	DISTANCE_CACHE_HALF = 1 << 11,
+	DISTANCE_CACHE_DOUBLE = 1 << 12,
+	SYMMETRIC = 1 << 13,
+	MIXED = 1 << 14,
+	DETERMINISTIC = 1 << 15,
+	AUTO = 1 << 16 // replaces SSE / AVX / AVX512 with the widest the CPU supports
 };
 
 } // namespace mds
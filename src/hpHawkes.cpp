@@ -1,6 +1,10 @@
 
 #include "AbstractHawkes.hpp"
-#include "NewHawkes.hpp"
+#include "Sampler.hpp"
+#include "MultiChain.hpp"
+#include "Optimizer.hpp"
+#include "Simulator.hpp"
+#include "EventFile.hpp"
 
 #include <Rcpp.h>
 using namespace Rcpp;
@@ -49,14 +53,27 @@ HphSharedPtr& parsePtr(SEXP sexp) {
 //' @param embeddingDimension Dimension of latent locations.
 //' @param locationCount Number of locations and size of distance matrix.
 //' @param tbb Number of CPU cores to be used.
-//' @param simd For CPU implementation: no SIMD (\code{0}), SSE (\code{1}) or AVX (\code{2}).
+//' @param simd For CPU implementation: no SIMD (\code{0}), SSE (\code{1}), AVX (\code{2}), AVX-512 (\code{3}) or
+//' the widest the CPU supports (\code{-1}).
 //' @param gpu Which GPU to use? If only 1 available, use \code{gpu=1}. Defaults to \code{0}, no GPU.
-//' @param single Set \code{single=1} if your GPU does not accommodate doubles.
+//' @param single Set \code{single=1} for single precision on the CPU, or if your GPU does not accommodate doubles.
+//' @param pruning For CPU implementation: visit all pairs (\code{0}), query a spatial index (\code{1}) or
+//' reuse a neighbour list (\code{2}).
+//' @param distanceCache For CPU implementation: cache pairwise distances in half (\code{1}), single (\code{2}) or
+//' double (\code{3}) precision. Defaults to \code{0}, no cache.
+//' @param mixed For CPU implementation: store events and evaluate pair kernels in single precision, but
+//' accumulate sums in double with compensation (\code{1}). Defaults to \code{0}.
+//' @param deterministic For CPU implementation: reduce in fixed blocks and a fixed tree, so that results are
+//' bitwise identical for any number of threads (\code{1}). Defaults to \code{0}.
+//' @param symmetric For CPU implementation without pruning: evaluate each unordered pair once and scatter it to
+//' both events (\code{1}). Defaults to \code{0}.
 //' @return HPH engine object.
 //'
 //' @export
 // [[Rcpp::export(createEngine)]]
-Rcpp::List createEngine(int embeddingDimension, int locationCount, int tbb, int simd, int gpu, bool single) {
+Rcpp::List createEngine(int embeddingDimension, int locationCount, int tbb, int simd, int gpu, bool single,
+                        int pruning = 0, int distanceCache = 0, int mixed = 0,
+                        int deterministic = 0, int symmetric = 0) {
 
   long flags = 0L;
 
@@ -73,6 +90,11 @@ Rcpp::List createEngine(int embeddingDimension, int locationCount, int tbb, int
   } else {
     Rcout << "Running on CPU" << std::endl;
 
+  if (single) {
+    flags |= hph::Flags::FLOAT;
+    Rcout << "Single precision" << std::endl;
+  }
+
 #if RCPP_PARALLEL_USE_TBB
   if (tbb > 0) {
     threads = tbb;
@@ -82,10 +104,41 @@ Rcpp::List createEngine(int embeddingDimension, int locationCount, int tbb, int
   }
 #endif
 
-  if (simd == 1) {
+  if (simd < 0) {
+    flags |= hph::Flags::AUTO;
+  } else if (simd == 1) {
     flags |= hph::Flags::SSE;
   } else if (simd == 2) {
     flags |= hph::Flags::AVX;
+  } else if (simd == 3) {
+    flags |= hph::Flags::AVX512;
+  }
+
+  if (pruning == 1) {
+    flags |= hph::Flags::SPATIAL_INDEX;
+  } else if (pruning == 2) {
+    flags |= hph::Flags::NEIGHBOUR_LIST;
+  }
+
+  if (distanceCache > 0) {
+    flags |= hph::Flags::DISTANCE_CACHE;
+    if (distanceCache == 1) {
+      flags |= hph::Flags::DISTANCE_CACHE_HALF;
+    } else if (distanceCache == 3) {
+      flags |= hph::Flags::DISTANCE_CACHE_DOUBLE;
+    }
+  }
+
+  if (mixed > 0) {
+    flags |= hph::Flags::MIXED;
+  }
+
+  if (deterministic > 0) {
+    flags |= hph::Flags::DETERMINISTIC;
+  }
+
+  if (symmetric > 0) {
+    flags |= hph::Flags::SYMMETRIC;
   }
 
   }
@@ -137,6 +190,20 @@ std::vector<double> getProbsSelfExcite(SEXP sexp, size_t len) {
   return result;
 }
 
+// [[Rcpp::export(.evaluateAll)]]
+Rcpp::List evaluateAll(SEXP sexp, size_t len) {
+  auto ptr = parsePtr(sexp);
+  double logLikelihood;
+  std::vector<double> gradient(6);
+  std::vector<double> probsSelfExcite(len);
+  ptr->evaluateAll(&logLikelihood, &gradient[0], &probsSelfExcite[0]);
+  return Rcpp::List::create(
+    Rcpp::Named("logLikelihood") = logLikelihood,
+    Rcpp::Named("gradient") = gradient,
+    Rcpp::Named("probsSelfExcite") = probsSelfExcite
+  );
+}
+
 // [[Rcpp::export(.updateLocations)]]
 void updateLocations(SEXP sexp,
                      std::vector<double>& locations) {
@@ -149,3 +216,258 @@ double getSumOfLikContribs(SEXP sexp) {
   auto ptr = parsePtr(sexp);
   return ptr->getSumOfLikContribs();
 }
+
+// [[Rcpp::export(.setTruncation)]]
+void setTruncation(SEXP sexp, double tolerance) {
+  auto ptr = parsePtr(sexp);
+  ptr->setTruncation(tolerance);
+}
+
+// [[Rcpp::export(.getTruncationErrorBound)]]
+double getTruncationErrorBound(SEXP sexp) {
+  auto ptr = parsePtr(sexp);
+  return ptr->getTruncationErrorBound();
+}
+
+// [[Rcpp::export(.getDistanceCacheFootprint)]]
+double getDistanceCacheFootprint(SEXP sexp) {
+  auto ptr = parsePtr(sexp);
+  return static_cast<double>(ptr->getDistanceCacheFootprint());
+}
+
+// [[Rcpp::export(.getSumOfLikContribsBatch)]]
+Rcpp::List getSumOfLikContribsBatch(SEXP sexp, std::vector<double>& parameters, int count, bool gradient) {
+  auto ptr = parsePtr(sexp);
+  std::vector<double> logLikelihoods(count);
+  std::vector<double> gradients(gradient ? 6 * count : 0);
+  ptr->getSumOfLikContribsBatch(&parameters[0], count, &logLikelihoods[0],
+                                gradient ? &gradients[0] : nullptr);
+  return Rcpp::List::create(
+    Rcpp::Named("logLikelihood") = logLikelihoods,
+    Rcpp::Named("gradient") = gradients
+  );
+}
+
+// [[Rcpp::export(.runSampler)]]
+Rcpp::List runSampler(SEXP sexp, std::vector<double>& parameters, int iterations, int burnIn, double radius,
+                      double seed) {
+  auto ptr = parsePtr(sexp);
+  const int count = iterations - burnIn;
+  std::vector<double> samples(6 * count);
+  std::vector<double> target(count);
+  hph::AdaptiveSampler sampler(*ptr, radius, static_cast<unsigned long>(seed));
+  sampler.run(&parameters[0], iterations, burnIn, &samples[0], &target[0]);
+  const auto& radii = sampler.getRadii();
+  return Rcpp::List::create(
+    Rcpp::Named("samples") = samples,
+    Rcpp::Named("target") = target,
+    Rcpp::Named("radii") = std::vector<double>(radii.begin(), radii.end())
+  );
+}
+
+// [[Rcpp::export(.runNuts)]]
+Rcpp::List runNuts(SEXP sexp, std::vector<double>& parameters, std::vector<int>& indices, int iterations,
+                   int burnIn, double seed, double targetAcceptance, int maxDepth) {
+  auto ptr = parsePtr(sexp);
+  const int count = iterations - burnIn;
+  std::vector<double> samples(6 * count);
+  std::vector<double> target(count);
+  hph::NutsSampler sampler(*ptr, indices, static_cast<unsigned long>(seed), targetAcceptance, maxDepth);
+  sampler.run(&parameters[0], iterations, burnIn, &samples[0], &target[0]);
+  return Rcpp::List::create(
+    Rcpp::Named("samples") = samples,
+    Rcpp::Named("target") = target,
+    Rcpp::Named("stepSize") = sampler.getStepSize(),
+    Rcpp::Named("evaluations") = static_cast<double>(sampler.getEvaluationCount())
+  );
+}
+
+// [[Rcpp::export(.runChains)]]
+Rcpp::List runChains(SEXP sexp, std::vector<double>& parameters, int chains, int threadsPerChain, int iterations,
+                     int burnIn, std::vector<double>& seeds, bool nuts, double radius, std::vector<int>& indices) {
+  auto ptr = parsePtr(sexp);
+  const int count = iterations - burnIn;
+  std::vector<std::vector<double>> samples(chains, std::vector<double>(6 * count));
+  std::vector<std::vector<double>> targets(chains, std::vector<double>(count));
+
+  hph::MultiChainDriver driver(*ptr, chains, threadsPerChain);
+  driver.run([&](const int chain, hph::AbstractHawkes& engine) {
+    const auto seed = static_cast<unsigned long>(seeds[chain]);
+    if (nuts) {
+      hph::NutsSampler sampler(engine, indices, seed);
+      sampler.run(&parameters[6 * chain], iterations, burnIn, &samples[chain][0], &targets[chain][0]);
+    } else {
+      hph::AdaptiveSampler sampler(engine, radius, seed);
+      sampler.run(&parameters[6 * chain], iterations, burnIn, &samples[chain][0], &targets[chain][0]);
+    }
+  });
+
+  Rcpp::List result(chains);
+  for (int chain = 0; chain < chains; ++chain) {
+    result[chain] = Rcpp::List::create(
+      Rcpp::Named("samples") = samples[chain],
+      Rcpp::Named("target") = targets[chain]
+    );
+  }
+  return result;
+}
+
+// [[Rcpp::export(.runTempering)]]
+Rcpp::List runTempering(SEXP sexp, std::vector<double>& parameters, std::vector<double>& inverseTemperatures,
+                        int iterations, int burnIn, double radius, double seed) {
+  auto ptr = parsePtr(sexp);
+  const int count = iterations - burnIn;
+  std::vector<double> samples(6 * count);
+  std::vector<double> target(count);
+  hph::TemperingSampler sampler(*ptr, inverseTemperatures, radius, static_cast<unsigned long>(seed));
+  sampler.run(&parameters[0], iterations, burnIn, &samples[0], &target[0]);
+  std::vector<double> acceptance(sampler.getChainCount());
+  for (int chain = 0; chain < sampler.getChainCount(); ++chain) {
+    acceptance[chain] = sampler.getAcceptanceRate(chain);
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("samples") = samples,
+    Rcpp::Named("target") = target,
+    Rcpp::Named("acceptance") = acceptance,
+    Rcpp::Named("swapRate") = sampler.getSwapAcceptanceRate()
+  );
+}
+
+// [[Rcpp::export(.optimizeMap)]]
+Rcpp::List optimizeMap(SEXP sexp, std::vector<double>& parameters, std::vector<int>& indices,
+                       std::vector<double>& lower, std::vector<double>& upper, int maxIterations,
+                       double tolerance) {
+  auto ptr = parsePtr(sexp);
+  std::vector<double> result(6);
+  hph::LbfgsOptimizer optimizer(*ptr, indices, lower, upper);
+  const double logPosterior = optimizer.run(&parameters[0], &result[0], maxIterations, tolerance);
+  return Rcpp::List::create(
+    Rcpp::Named("parameters") = result,
+    Rcpp::Named("logPosterior") = logPosterior,
+    Rcpp::Named("iterations") = optimizer.getIterationCount(),
+    Rcpp::Named("evaluations") = static_cast<double>(optimizer.getEvaluationCount()),
+    Rcpp::Named("converged") = optimizer.hasConverged()
+  );
+}
+
+// [[Rcpp::export(.simulateEvents)]]
+Rcpp::List simulateEvents(std::vector<double>& parameters, int embeddingDimension, int eventCount, double seed,
+                          double spread, int threads, int centreCount = 0) {
+  std::vector<double> times;
+  std::vector<double> locations;
+  hph::HawkesSimulator simulator(embeddingDimension, &parameters[0], static_cast<unsigned long>(seed), spread,
+                                 threads);
+  if (centreCount > 0) { // Every event of that many centres on a horizon of the same length
+    simulator.simulate(centreCount, static_cast<double>(centreCount), times, locations);
+  } else {
+    simulator.simulate(eventCount, times, locations);
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("times") = times,
+    Rcpp::Named("locations") = locations
+  );
+}
+
+// [[Rcpp::export(.appendEvents)]]
+void appendEvents(SEXP sexp, std::vector<double>& times, std::vector<double>& locations) {
+  auto ptr = parsePtr(sexp);
+  ptr->appendEvents(&times[0], &locations[0], times.size());
+}
+
+// [[Rcpp::export(.setWindow)]]
+void setWindow(SEXP sexp, double length) {
+  auto ptr = parsePtr(sexp);
+  ptr->setWindow(length);
+}
+
+// [[Rcpp::export(.getLocationCount)]]
+int getLocationCount(SEXP sexp) {
+  auto ptr = parsePtr(sexp);
+  return ptr->getLocationCount();
+}
+
+// [[Rcpp::export(.evaluateIntensity)]]
+Rcpp::List evaluateIntensity(SEXP sexp, std::vector<double>& locations, std::vector<double>& times) {
+  auto ptr = parsePtr(sexp);
+  const auto count = times.size();
+  std::vector<double> intensity(count);
+  std::vector<double> background(count);
+  std::vector<double> selfExcite(count);
+  if (count > 0) {
+    ptr->evaluateIntensity(&locations[0], &times[0], count, &intensity[0], &background[0], &selfExcite[0]);
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("intensity") = intensity,
+    Rcpp::Named("background") = background,
+    Rcpp::Named("selfExcite") = selfExcite
+  );
+}
+
+// [[Rcpp::export(.evaluateCompensator)]]
+Rcpp::List evaluateCompensator(SEXP sexp, std::vector<double>& lower, std::vector<double>& upper,
+                               std::vector<double>& startTimes, std::vector<double>& endTimes) {
+  auto ptr = parsePtr(sexp);
+  const auto count = startTimes.size();
+  std::vector<double> expected(count);
+  std::vector<double> background(count);
+  std::vector<double> selfExcite(count);
+  if (count > 0) {
+    ptr->evaluateCompensator(&lower[0], &upper[0], &startTimes[0], &endTimes[0], count,
+                             &expected[0], &background[0], &selfExcite[0]);
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("expected") = expected,
+    Rcpp::Named("background") = background,
+    Rcpp::Named("selfExcite") = selfExcite
+  );
+}
+
+// [[Rcpp::export(.writeEventFile)]]
+void writeEventFile(const std::string& path, std::vector<double>& times, std::vector<double>& locations,
+                    int embeddingDimension) {
+  hph::writeEventFile(path, &times[0], &locations[0], times.size(), embeddingDimension);
+}
+
+// [[Rcpp::export(.readEventFileHeader)]]
+Rcpp::List readEventFileHeader(const std::string& path) {
+  hph::MappedEventFile file(path);
+  return Rcpp::List::create(
+    Rcpp::Named("embeddingDimension") = file.getEmbeddingDimension(),
+    Rcpp::Named("eventCount") = file.getEventCount()
+  );
+}
+
+// [[Rcpp::export(.loadEventFile)]]
+double loadEventFile(SEXP sexp, const std::string& path) {
+  auto ptr = parsePtr(sexp);
+  hph::MappedEventFile file(path);
+  file.load(*ptr);
+  // An empty file leaves nothing to precede later appends
+  return file.getEventCount() > 0 ? file.getTimes()[file.getEventCount() - 1] : R_NegInf;
+}
+
+// [[Rcpp::export(.saveState)]]
+void saveState(SEXP sexp, const std::string& path, std::vector<double>& extra) {
+  auto ptr = parsePtr(sexp);
+  ptr->saveState(path, extra.empty() ? nullptr : &extra[0], extra.size());
+}
+
+// [[Rcpp::export(.loadState)]]
+std::vector<double> loadState(SEXP sexp, const std::string& path) {
+  auto ptr = parsePtr(sexp);
+  std::vector<double> extra;
+  ptr->loadState(path, &extra);
+  return extra;
+}
+
+// [[Rcpp::export(.storeState)]]
+void storeState(SEXP sexp) {
+  auto ptr = parsePtr(sexp);
+  ptr->storeState();
+}
+
+// [[Rcpp::export(.restoreState)]]
+void restoreState(SEXP sexp) {
+  auto ptr = parsePtr(sexp);
+  ptr->restoreState();
+}
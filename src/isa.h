@@ -0,0 +1,35 @@
+#ifndef _ISA_H
+#define _ISA_H
+
+// Everything the engine units (backend/cpu/instantiate_*.cpp) compile with their own SIMD flags lives in an
+// inline namespace named after the unit's instruction set, which each unit defines as HPH_ISA before any
+// include. Inline functions and template instantiations then get distinct symbols per ISA, so the linker
+// can never substitute, say, the AVX-512 copy of a helper into the portable engine. Units built with the
+// baseline flags (factory, R and JNI glue, benchmark) share the "baseline" namespace.
+#ifndef HPH_ISA
+#define HPH_ISA baseline
+#endif
+
+#define HPH_ISA_NAMESPACE_BEGIN inline namespace HPH_ISA {
+#define HPH_ISA_NAMESPACE_END }
+
+// Library headers (std, TBB, Rcpp) cannot be put in a namespace, so their inline functions keep one symbol
+// across all units; included between these, they are compiled for the baseline x86-64 ISA whatever the unit's
+// flags, and every copy the linker may keep is safe on any CPU.
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__clang__)
+#define HPH_LIBRARY_CODE_BEGIN \
+    _Pragma("clang attribute push(__attribute__((target(\"no-sse3\"))), apply_to = function)")
+#define HPH_LIBRARY_CODE_END _Pragma("clang attribute pop")
+#elif defined(__GNUC__)
+#define HPH_LIBRARY_CODE_BEGIN _Pragma("GCC push_options") _Pragma("GCC target(\"no-sse3\")")
+#define HPH_LIBRARY_CODE_END _Pragma("GCC pop_options")
+#endif
+#endif
+
+#ifndef HPH_LIBRARY_CODE_BEGIN
+#define HPH_LIBRARY_CODE_BEGIN
+#define HPH_LIBRARY_CODE_END
+#endif
+
+#endif // _ISA_H
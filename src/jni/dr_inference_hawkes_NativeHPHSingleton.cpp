@@ -3,7 +3,8 @@
 #include <iostream>
 
 // #include "Hawkes.hpp"
-#include "NewHawkes.hpp"
+#include "AbstractHawkes.hpp"
+#include "Sampler.hpp"
 #include "dr_inference_hawkes_NativeHPHSingleton.h"
 
 typedef std::shared_ptr<hph::AbstractHawkes> InstancePtr;
@@ -105,6 +106,22 @@ JNIEXPORT jint JNICALL Java_dr_inference_hawkes_NativeHPHSingleton_getInternalDi
     return instances[instance]->getInternalDimension();
 }
 
+extern "C"
+JNIEXPORT void JNICALL Java_dr_inference_hawkes_NativeHPHSingleton_runSampler
+        (JNIEnv *env, jobject, jint instance, jdoubleArray initialArray, jint iterations, jint burnIn,
+         jdouble radius, jlong seed, jdoubleArray samplesArray, jdoubleArray potentialsArray) {
+    jdouble* initial = env->GetDoubleArrayElements(initialArray, NULL);
+    jdouble* samples = env->GetDoubleArrayElements(samplesArray, NULL);
+    jdouble* potentials = env->GetDoubleArrayElements(potentialsArray, NULL);
+
+    hph::AdaptiveSampler sampler(*instances[instance], radius, static_cast<unsigned long>(seed));
+    sampler.run(initial, iterations, burnIn, samples, potentials);
+
+    env->ReleaseDoubleArrayElements(initialArray, initial, JNI_ABORT);
+    env->ReleaseDoubleArrayElements(samplesArray, samples, 0); // copy values back
+    env->ReleaseDoubleArrayElements(potentialsArray, potentials, 0);
+}
+
 
 // jsize len = (*env)->GetArrayLength(env, arr);
 //     jdouble *partials = env->GetDoubleArrayElements(inPartials, NULL);
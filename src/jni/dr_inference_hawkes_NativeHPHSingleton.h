@@ -97,6 +97,14 @@ JNIEXPORT void JNICALL Java_dr_inference_hawkes_NativeHPHSingleton_getLocationGr
 
 JNIEXPORT jint JNICALL Java_dr_inference_hawkes_NativeHPHSingleton_getInternalDimension
         (JNIEnv *, jobject, jint);
+
+/*
+ * Class:     dr_inference_hawkes_NativeHPHSingleton
+ * Method:    runSampler
+ * Signature: (I[DIIDJ[D[D)V
+ */
+JNIEXPORT void JNICALL Java_dr_inference_hawkes_NativeHPHSingleton_runSampler
+  (JNIEnv *, jobject, jint, jdoubleArray, jint, jint, jdouble, jlong, jdoubleArray, jdoubleArray);
 #ifdef __cplusplus
 }
 #endif